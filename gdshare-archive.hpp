@@ -0,0 +1,292 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <future>
+#include <fstream>
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include "gdshare.hpp"
+#include "gdshare-codec.hpp"
+#include "gdshare-io.hpp"
+#include "gdshare-pool.hpp"
+#include "gdshare-view.hpp"
+#include "gdshare-xml.hpp"
+
+namespace gdshare {
+    /**
+     * A single file holding many levels, for backups. Each level's XML
+     * (the same text a .gmd file holds) is gzipped on its own, so one level
+     * can be read back without touching the others.
+     *
+     * Layout: "GDSA" magic and version, the gzipped levels back to back,
+     * then the index, then the index's offset and the magic again. The
+     * index goes last so the file can be written in one sequential pass.
+    */
+    struct LevelArchive {
+        static constexpr uint32_t Magic = 0x41534447; // "GDSA"
+        static constexpr uint32_t Version = 1;
+
+        /**
+         * A level in the archive.
+        */
+        struct Entry {
+            std::string name;
+            uint64_t offset;
+            uint64_t size;
+            uint64_t rawSize;
+            uint32_t crc;
+        };
+
+        /**
+         * Writes an archive. Levels are compressed in parallel, and written
+         * in the order they were added as they finish.
+        */
+        struct Writer {
+            /**
+             * Start writing an archive. Check isOpen() for success.
+             * @param path The archive to create; an existing file is only
+             * replaced once the archive is complete
+             * @param options Compression level and thread count
+            */
+            Writer(const std::string & path, codec::GZipOptions options = {})
+              : $file(path, io::Durability::Data), $level(options.level),
+                $threads(options.threads ? options.threads : ThreadPool::defaultSize()), $pool($threads) {
+                uint32_t head[2] = { Magic, Version };
+                this->put(head, sizeof head);
+            }
+
+            Writer(const Writer &) = delete;
+            Writer & operator= (const Writer &) = delete;
+
+            ~Writer() {
+                for (auto & job : $pending)
+                    job.result.wait();
+            }
+
+            /**
+             * Whether the archive could be created.
+            */
+            bool isOpen() const {
+                return $file.isOpen();
+            }
+
+            /**
+             * Queue a level. The level is read on a worker thread, so it
+             * has to stay alive and unmodified until finish() returns.
+             * @returns false if writing has failed
+            */
+            bool add(const Level* level) {
+                int compression = $level;
+                $pending.push_back({ std::string(view::name(level)), $pool.run([level, compression]() -> Packed {
+                    Packed res;
+                    std::string text;
+                    xml::Writer writer ([&text](const uint8_t* data, size_t size) -> bool {
+                        text.append(reinterpret_cast<const char*>(data), size);
+                        return true;
+                    });
+                    writer.print(level->xml);
+                    writer.finish();
+
+                    auto raw = reinterpret_cast<const uint8_t*>(text.data());
+                    res.rawSize = text.size();
+                    res.crc = codec::backend::current().crc32(0, raw, text.size());
+                    res.data = codec::backend::current().gzip(raw, text.size(), compression);
+                    return res;
+                }) });
+
+                while ($pending.size() > 2 * static_cast<size_t>($threads) && $ok)
+                    this->drain();
+                return $ok;
+            }
+
+            /**
+             * Write the remaining levels and the index, and put the
+             * archive in place.
+             * @returns gdshare::Result
+            */
+            Result finish() {
+                while (!$pending.empty())
+                    this->drain();
+                if (!$ok) {
+                    $file.discard();
+                    return { false, "Unable to write archive" };
+                }
+
+                uint64_t indexOffset = $offset;
+                uint64_t count = $entries.size();
+                this->put(&count, sizeof count);
+                for (auto & entry : $entries) {
+                    uint32_t len = static_cast<uint32_t>(entry.name.size());
+                    this->put(&len, sizeof len);
+                    this->put(entry.name.data(), len);
+                    this->put(&entry.offset, sizeof entry.offset);
+                    this->put(&entry.size, sizeof entry.size);
+                    this->put(&entry.rawSize, sizeof entry.rawSize);
+                    this->put(&entry.crc, sizeof entry.crc);
+                }
+                this->put(&indexOffset, sizeof indexOffset);
+                this->put(&Magic, sizeof Magic);
+
+                if (!$ok) {
+                    $file.discard();
+                    return { false, "Unable to write archive" };
+                }
+                return $file.commit();
+            }
+
+            /**
+             * Get the levels written so far.
+            */
+            const std::vector<Entry> & entries() const {
+                return $entries;
+            }
+
+            private:
+                struct Packed {
+                    std::vector<uint8_t> data;
+                    uint64_t rawSize = 0;
+                    uint32_t crc = 0;
+                };
+
+                struct Job {
+                    std::string name;
+                    std::future<Packed> result;
+                };
+
+                void drain() {
+                    Job job = std::move($pending.front());
+                    $pending.pop_front();
+                    Packed packed = job.result.get();
+                    if (packed.data.empty()) {
+                        $ok = false;
+                        return;
+                    }
+
+                    $entries.push_back({ std::move(job.name), $offset, packed.data.size(), packed.rawSize, packed.crc });
+                    this->put(packed.data.data(), packed.data.size());
+                }
+
+                void put(const void* data, size_t size) {
+                    if (!$ok) return;
+                    $ok = $file.write(static_cast<const uint8_t*>(data), size);
+                    $offset += size;
+                }
+
+                io::AtomicWriter $file;
+                int $level;
+                unsigned int $threads;
+                uint64_t $offset = 0;
+                std::vector<Entry> $entries;
+                ThreadPool $pool;
+                std::deque<Job> $pending;
+                bool $ok = true;
+        };
+
+        /**
+         * Open an archive and read its index.
+         * @param path The archive
+         * @returns gdshare::Result
+        */
+        Result open(const std::string & path) {
+            $entries.clear();
+            $file = std::ifstream(path, std::ios::binary);
+            if (!$file.is_open())
+                return { false, "Unable to open " + path };
+
+            auto get = [this](auto & value) -> bool {
+                $file.read(reinterpret_cast<char*>(&value), sizeof value);
+                return static_cast<bool>($file);
+            };
+
+            uint32_t head[2] = { 0, 0 };
+            if (!get(head) || head[0] != Magic || head[1] != Version)
+                return { false, path + " is not a level archive" };
+
+            $file.seekg(-static_cast<std::streamoff>(sizeof(uint64_t) + sizeof(uint32_t)), std::ios::end);
+            uint64_t indexOffset = 0;
+            uint32_t magic = 0;
+            if (!get(indexOffset) || !get(magic) || magic != Magic)
+                return { false, path + " is incomplete" };
+
+            $file.seekg(static_cast<std::streamoff>(indexOffset));
+            uint64_t count = 0;
+            if (!get(count))
+                return { false, path + " has a broken index" };
+
+            for (uint64_t ix = 0; ix < count; ix++) {
+                Entry entry;
+                uint32_t len = 0;
+                if (!get(len) || len > indexOffset)
+                    return { false, path + " has a broken index" };
+                entry.name.resize(len);
+                $file.read(entry.name.data(), len);
+                if (!get(entry.offset) || !get(entry.size) || !get(entry.rawSize) || !get(entry.crc) ||
+                    entry.offset + entry.size > indexOffset)
+                    return { false, path + " has a broken index" };
+                $entries.push_back(std::move(entry));
+            }
+
+            return { true, "" };
+        }
+
+        /**
+         * Get the levels in the archive, in the order they were added.
+        */
+        const std::vector<Entry> & entries() const {
+            return $entries;
+        }
+
+        /**
+         * Find a level by its name.
+         * @param name The level's name
+         * @param casesensitive Whether to match the name case-sensitive
+         * @returns The level's position in the archive, or -1 if not found
+        */
+        long long find(std::string_view name, bool casesensitive = false) const {
+            auto eq = [casesensitive](unsigned char a, unsigned char b) {
+                return casesensitive ? a == b : std::tolower(a) == std::tolower(b);
+            };
+            for (size_t ix = 0; ix < $entries.size(); ix++) {
+                auto & lvl = $entries[ix].name;
+                if (lvl.size() == name.size() && std::equal(lvl.begin(), lvl.end(), name.begin(), eq))
+                    return static_cast<long long>(ix);
+            }
+            return -1;
+        }
+
+        /**
+         * Read one level's XML. Only that level's bytes are read.
+         * @param ix The level's position in the archive
+         * @param out Receives the XML
+         * @returns gdshare::Result
+        */
+        Result read(size_t ix, std::string & out) {
+            if (ix >= $entries.size())
+                return { false, "No such level" };
+            auto & entry = $entries[ix];
+
+            std::vector<uint8_t> gz (entry.size);
+            $file.clear();
+            $file.seekg(static_cast<std::streamoff>(entry.offset));
+            $file.read(reinterpret_cast<char*>(gz.data()), gz.size());
+            if (!$file)
+                return { false, "Unable to read \"" + entry.name + "\"" };
+
+            out.clear();
+            out.reserve(entry.rawSize);
+            if (!codec::inflateInto(gz.data(), gz.size(), out) || out.size() != entry.rawSize ||
+                codec::backend::current().crc32(0, reinterpret_cast<const uint8_t*>(out.data()), out.size()) != entry.crc)
+                return { false, "\"" + entry.name + "\" is corrupted" };
+
+            return { true, "" };
+        }
+
+        private:
+            std::ifstream $file;
+            std::vector<Entry> $entries;
+    };
+}
@@ -0,0 +1,300 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <zlib.h>
+
+#ifdef GDSHARE_WITH_LIBDEFLATE
+    #include <libdeflate.h>
+#endif
+#ifdef GDSHARE_WITH_ZLIBNG
+    #include <zlib-ng.h>
+#endif
+
+namespace gdshare {
+    namespace codec {
+        /**
+         * Compression libraries for whole-buffer gzip work. zlib is always
+         * there; libdeflate and zlib-ng (native API) are compiled in with
+         * GDSHARE_WITH_LIBDEFLATE / GDSHARE_WITH_ZLIBNG. The streaming
+         * stages (StreamDecoder, GZipStream) need zlib's dictionary and
+         * flush API, which libdeflate doesn't have; they use whichever
+         * library provides zlib.h, so linking zlib-ng's compat build swaps
+         * them over too.
+        */
+        namespace backend {
+            enum class Kind {
+                Zlib,
+                Libdeflate,
+                ZlibNg
+            };
+
+            /**
+             * One-shot operations of a backend.
+            */
+            struct Backend {
+                Kind kind;
+                const char* name;
+                /**
+                 * Inflate a complete gzip or zlib stream, appending to out.
+                 * Returns false if the data isn't a complete stream.
+                */
+                bool (*inflate)(const uint8_t* data, size_t size, std::string & out);
+                /**
+                 * Compress into a gzip stream. Returns an empty vector on failure.
+                */
+                std::vector<uint8_t> (*gzip)(const uint8_t* data, size_t size, int level);
+                /**
+                 * Update a CRC-32.
+                */
+                uint32_t (*crc32)(uint32_t crc, const uint8_t* data, size_t size);
+            };
+
+            namespace detail {
+                // growth step for inflate output
+                static constexpr size_t Step = 0x10000;
+
+                /**
+                 * Length stored in a gzip trailer, a good first guess for
+                 * the output size.
+                */
+                inline size_t gzipSizeHint(const uint8_t* data, size_t size) {
+                    if (size < 18 || data[0] != 0x1f || data[1] != 0x8b)
+                        return size * 4;
+                    uint32_t isize;
+                    std::memcpy(&isize, data + size - 4, 4);
+                    return isize ? isize : size * 4;
+                }
+
+                /**
+                 * Give a gzip stream the header GD writes: no name, no
+                 * mtime, OS = NTFS.
+                */
+                inline void gdHeader(std::vector<uint8_t> & gz) {
+                    static const uint8_t header[] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0x0b };
+                    if (gz.size() >= sizeof header && !(gz[3] & 0x1e))
+                        std::memcpy(gz.data(), header, sizeof header);
+                }
+
+                inline bool zlibInflate(const uint8_t* data, size_t size, std::string & out) {
+                    z_stream zs;
+                    std::memset(&zs, 0, sizeof zs);
+                    // 15 + 32 = auto-detect zlib / gzip header
+                    if (inflateInit2(&zs, 15 + 32) != Z_OK)
+                        return false;
+
+                    size_t used = out.size();
+                    zs.next_in = const_cast<Bytef*>(data);
+                    zs.avail_in = static_cast<uInt>(size);
+
+                    int ret = Z_OK;
+                    while (ret == Z_OK) {
+                        if (out.size() - used < Step)
+                            out.resize(std::max(out.size() * 2, used + Step));
+                        zs.next_out = reinterpret_cast<Bytef*>(&out[used]);
+                        zs.avail_out = static_cast<uInt>(out.size() - used);
+                        ret = ::inflate(&zs, Z_NO_FLUSH);
+                        used = out.size() - zs.avail_out;
+                    }
+                    inflateEnd(&zs);
+
+                    out.resize(used);
+                    return ret == Z_STREAM_END;
+                }
+
+                inline std::vector<uint8_t> zlibGZip(const uint8_t* data, size_t size, int level) {
+                    z_stream zs;
+                    std::memset(&zs, 0, sizeof zs);
+                    // 15 + 16 = gzip wrapper
+                    if (deflateInit2(&zs, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+                        return {};
+
+                    std::vector<uint8_t> res (deflateBound(&zs, static_cast<uLong>(size)));
+                    zs.next_in = const_cast<Bytef*>(data);
+                    zs.avail_in = static_cast<uInt>(size);
+                    zs.next_out = res.data();
+                    zs.avail_out = static_cast<uInt>(res.size());
+                    bool ok = ::deflate(&zs, Z_FINISH) == Z_STREAM_END;
+                    res.resize(res.size() - zs.avail_out);
+                    deflateEnd(&zs);
+
+                    if (!ok) return {};
+                    gdHeader(res);
+                    return res;
+                }
+
+                inline uint32_t zlibCrc32(uint32_t crc, const uint8_t* data, size_t size) {
+                    return static_cast<uint32_t>(::crc32(crc, data, static_cast<uInt>(size)));
+                }
+
+                #ifdef GDSHARE_WITH_LIBDEFLATE
+                inline bool libdeflateInflate(const uint8_t* data, size_t size, std::string & out) {
+                    libdeflate_decompressor* dec = libdeflate_alloc_decompressor();
+                    if (!dec) return false;
+
+                    bool gzip = size >= 2 && data[0] == 0x1f && data[1] == 0x8b;
+                    size_t base = out.size(), cap = std::max(detail::gzipSizeHint(data, size), Step);
+                    libdeflate_result ret;
+                    for (;;) {
+                        out.resize(base + cap);
+                        size_t written = 0;
+                        ret = gzip ?
+                            libdeflate_gzip_decompress(dec, data, size, &out[base], cap, &written) :
+                            libdeflate_zlib_decompress(dec, data, size, &out[base], cap, &written);
+                        if (ret != LIBDEFLATE_INSUFFICIENT_SPACE) {
+                            out.resize(base + (ret == LIBDEFLATE_SUCCESS ? written : 0));
+                            break;
+                        }
+                        // the trailer only holds the size mod 4 GB
+                        cap *= 2;
+                    }
+                    libdeflate_free_decompressor(dec);
+                    return ret == LIBDEFLATE_SUCCESS;
+                }
+
+                inline std::vector<uint8_t> libdeflateGZip(const uint8_t* data, size_t size, int level) {
+                    libdeflate_compressor* enc = libdeflate_alloc_compressor(level < 0 ? 6 : std::min(level, 12));
+                    if (!enc) return {};
+                    std::vector<uint8_t> res (libdeflate_gzip_compress_bound(enc, size));
+                    res.resize(libdeflate_gzip_compress(enc, data, size, res.data(), res.size()));
+                    libdeflate_free_compressor(enc);
+                    gdHeader(res);
+                    return res;
+                }
+
+                inline uint32_t libdeflateCrc32(uint32_t crc, const uint8_t* data, size_t size) {
+                    return libdeflate_crc32(crc, data, size);
+                }
+                #endif
+
+                #ifdef GDSHARE_WITH_ZLIBNG
+                inline bool zlibNgInflate(const uint8_t* data, size_t size, std::string & out) {
+                    zng_stream zs;
+                    std::memset(&zs, 0, sizeof zs);
+                    if (zng_inflateInit2(&zs, 15 + 32) != Z_OK)
+                        return false;
+
+                    size_t used = out.size();
+                    zs.next_in = data;
+                    zs.avail_in = static_cast<uint32_t>(size);
+
+                    int ret = Z_OK;
+                    while (ret == Z_OK) {
+                        if (out.size() - used < Step)
+                            out.resize(std::max(out.size() * 2, used + Step));
+                        zs.next_out = reinterpret_cast<uint8_t*>(&out[used]);
+                        zs.avail_out = static_cast<uint32_t>(out.size() - used);
+                        ret = zng_inflate(&zs, Z_NO_FLUSH);
+                        used = out.size() - zs.avail_out;
+                    }
+                    zng_inflateEnd(&zs);
+
+                    out.resize(used);
+                    return ret == Z_STREAM_END;
+                }
+
+                inline std::vector<uint8_t> zlibNgGZip(const uint8_t* data, size_t size, int level) {
+                    zng_stream zs;
+                    std::memset(&zs, 0, sizeof zs);
+                    if (zng_deflateInit2(&zs, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+                        return {};
+
+                    std::vector<uint8_t> res (zng_deflateBound(&zs, size));
+                    zs.next_in = data;
+                    zs.avail_in = static_cast<uint32_t>(size);
+                    zs.next_out = res.data();
+                    zs.avail_out = static_cast<uint32_t>(res.size());
+                    bool ok = zng_deflate(&zs, Z_FINISH) == Z_STREAM_END;
+                    res.resize(res.size() - zs.avail_out);
+                    zng_deflateEnd(&zs);
+
+                    if (!ok) return {};
+                    gdHeader(res);
+                    return res;
+                }
+
+                inline uint32_t zlibNgCrc32(uint32_t crc, const uint8_t* data, size_t size) {
+                    return zng_crc32_z(crc, data, size);
+                }
+                #endif
+
+                inline const Backend Table[] = {
+                    { Kind::Zlib, "zlib", zlibInflate, zlibGZip, zlibCrc32 },
+                    #ifdef GDSHARE_WITH_LIBDEFLATE
+                    { Kind::Libdeflate, "libdeflate", libdeflateInflate, libdeflateGZip, libdeflateCrc32 },
+                    #endif
+                    #ifdef GDSHARE_WITH_ZLIBNG
+                    { Kind::ZlibNg, "zlib-ng", zlibNgInflate, zlibNgGZip, zlibNgCrc32 },
+                    #endif
+                };
+
+                /**
+                 * The fastest backend compiled in, or the one named by the
+                 * GDSHARE_BACKEND environment variable.
+                */
+                inline const Backend* initial() {
+                    if (const char* name = std::getenv("GDSHARE_BACKEND"))
+                        for (auto & backend : Table)
+                            if (!std::strcmp(backend.name, name))
+                                return &backend;
+
+                    for (Kind kind : { Kind::Libdeflate, Kind::ZlibNg })
+                        for (auto & backend : Table)
+                            if (backend.kind == kind)
+                                return &backend;
+                    return &Table[0];
+                }
+
+                inline std::atomic<const Backend*> & selected() {
+                    static std::atomic<const Backend*> backend { initial() };
+                    return backend;
+                }
+            }
+
+            /**
+             * Get all backends compiled into this build.
+            */
+            inline std::vector<const Backend*> available() {
+                std::vector<const Backend*> res;
+                for (auto & backend : detail::Table)
+                    res.push_back(&backend);
+                return res;
+            }
+
+            /**
+             * Get a backend by kind.
+             * @returns The backend, or nullptr if it isn't compiled in
+            */
+            inline const Backend* get(Kind kind) {
+                for (auto & backend : detail::Table)
+                    if (backend.kind == kind)
+                        return &backend;
+                return nullptr;
+            }
+
+            /**
+             * Get the backend currently in use.
+            */
+            inline const Backend & current() {
+                return *detail::selected().load(std::memory_order_relaxed);
+            }
+
+            /**
+             * Switch backends at runtime.
+             * @param kind The backend to use
+             * @returns false if it isn't compiled in
+            */
+            inline bool select(Kind kind) {
+                auto backend = get(kind);
+                if (!backend) return false;
+                detail::selected().store(backend, std::memory_order_relaxed);
+                return true;
+            }
+        }
+    }
+}
@@ -1,14 +1,20 @@
 #include <iostream>
 #include <vector>
 #include <string>
-#include <conio.h>
 #include <cctype>
 #include <locale>
 #include <sstream>
 #include <algorithm>
 #include <map>
-#include <Windows.h>
+#include <chrono>
+#include <iomanip>
+#include <filesystem>
+#include <fstream>
+// before anything that includes Windows.h, see gdshare-ipc.hpp
+#include "gdshare-ipc.hpp"
+#include "gdshare-term.hpp"
 #include "gdshare.hpp"
+#include "gdshare-local.hpp"
 
 using namespace gdshare;
 
@@ -42,209 +48,312 @@ namespace gdscli {
         return !str[h] ? 5381 : (h$(str, h+1) * 33) ^ str[h];
     }
 
-    bool isBreakChar(char c) {
-        return c == 27;
-    };
-
     static constexpr const int max_search = 10;
     static constexpr const char* version = "v1.0 Beta";
 
-    HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
-    COORD CursorPosition;
-
-    void gotoXY(int _x, int _y) {
-        CursorPosition.X = _x;
-        CursorPosition.Y = _y;
-        SetConsoleCursorPosition(console, CursorPosition);
-    };
+    // time fn, best of a few runs, in MB/s of size bytes
+    template<class F>
+    static double throughput(size_t size, F fn) {
+        double best = 0;
+        for (int run = 0; run < 3; run++) {
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+            best = std::max(best, size / 1e6 / std::max(took.count(), 1e-9));
+        }
+        return best;
+    }
 
-    int printSearchedLevels(std::vector<Level*> _lvls, std::string _srch) {
-        std::stringstream list;
-        int found = 0;
-
-        for (Level* lvl : _lvls) {
-            std::string name = lvl->name();
-            trim(name);
-            trim(_srch);
-            lower(name);
-            lower(_srch);
-            if (name.find(_srch) != std::string::npos) {
-                if (found < max_search)
-                    list
-                        << " * " << lvl->name()
-                        << " (" << lvl->length()
-                        << ", " << lvl->objectCount()
-                        << " objs)\n";
-                found++;
-            }
+    void benchBackends(const std::string & path) {
+        io::MappedFile file (path);
+        if (!file.isOpen()) {
+            std::cout << "Unable to open " << path << std::endl;
+            return;
         }
-        
-        if (found < max_search)
-            for (int i = 0; i < max_search - found; i++)
-                list << "\n";
 
-        else if (found == max_search)
-            list << "\n";
+        // undo the XOR and Base64 stages to get at the gzip stream
+        std::vector<uint8_t> gz (file.size());
+        codec::xorInto(gz.data(), file.data(), file.size(), codec::SaveKey);
+        gz.resize(codec::base64DecodeInPlace(gz.data(), gz.size()));
 
-        else list << "...\n";
+        std::string xml;
+        if (!codec::backend::get(codec::backend::Kind::Zlib)->inflate(gz.data(), gz.size(), xml)) {
+            std::cout << path << " is not an encoded save" << std::endl;
+            return;
+        }
 
-        std::cout << "Found " << found << " results for \"" << _srch << "\":\n" << list.str();
+        std::cout << path << ": " << gz.size() << " bytes compressed, " << xml.size() << " bytes of XML\n\n"
+            << std::left << std::setw(12) << "Backend"
+            << std::setw(16) << "Inflate MB/s"
+            << std::setw(16) << "Deflate MB/s"
+            << std::setw(12) << "Ratio"
+            << "CRC-32 MB/s\n";
+
+        const uint8_t* text = reinterpret_cast<const uint8_t*>(xml.data());
+        for (auto backend : codec::backend::available()) {
+            std::vector<uint8_t> packed;
+            std::string out;
+            uint32_t crc = 0;
+
+            double inflate = throughput(xml.size(), [&]() {
+                out.clear();
+                backend->inflate(gz.data(), gz.size(), out);
+            });
+            double deflate = throughput(xml.size(), [&]() {
+                packed = backend->gzip(text, xml.size(), Z_DEFAULT_COMPRESSION);
+            });
+            double crc32 = throughput(xml.size(), [&]() {
+                crc = backend->crc32(crc, text, xml.size());
+            });
+
+            std::cout << std::left << std::fixed << std::setprecision(1)
+                << std::setw(12) << backend->name
+                << std::setw(16) << inflate
+                << std::setw(16) << deflate
+                << std::setw(12) << (packed.empty() ? 0.0 : 100.0 * packed.size() / xml.size())
+                << crc32
+                << (out == xml ? "" : "  (inflate mismatch!)") << "\n";
+        }
 
-        if (found < max_search)
-            return found;
-        else return max_search;
-    };
+        std::cout << "\nIn use: " << codec::backend::current().name
+            << " (set GDSHARE_BACKEND to change)" << std::endl;
+    }
 
-    void processInput(int ac, char* av[]) {
-        if (ac < 2) {
-            std::cout << "Use \"./gdshare.exe help\" for help." << std::endl;
-            return;
+    /**
+     * The save commands work on. Loaded on first use, so commands that
+     * don't need it don't pay for decoding. A one-off command saves right
+     * after changing something; serve keeps one session across requests
+     * and saves on its own schedule.
+    */
+    struct Session {
+        CCLocalLevelsX* local = nullptr;
+        // save after every command that changes the save
+        bool autosave = true;
+        // whether commands may take over the terminal
+        bool interactive = true;
+        // files imported since the last save, applied again if the save
+        // has to be reloaded before then
+        std::vector<std::string> pending;
+        // directory relative paths are resolved against, "" for the
+        // current one
+        std::string dir;
+
+        Session() = default;
+        Session(const Session &) = delete;
+        Session & operator= (const Session &) = delete;
+
+        ~Session() {
+            delete local;
         }
 
-        std::vector<std::string> args;
-        for (int i = 0; i < ac; i++)
-            args.assign(av + 1, av + ac);
+        /**
+         * Resolve a path given in a command against Session::dir.
+        */
+        std::string resolve(const std::string & path) const {
+            if (dir.empty()) return path;
+            return (std::filesystem::path(dir) / path).string();
+        }
 
-        switch (h$(args[0].c_str())) {
-            case h$("list"): {
+        CCLocalLevelsX* levels() {
+            if (!local) {
                 std::cout << "Loading levels..." << std::endl;
 
-                CCLocalLevels* local = new CCLocalLevels([](std::string s, int p) -> void {
+                local = new CCLocalLevelsX([](std::string, int p) -> void {
                     std::cout << p << "% ";
                 });
 
                 std::cout << "\n\n";
+            }
+            return local;
+        }
 
-                std::vector<Level*> lvls = local->getLevels();
+        bool dirty() const {
+            return !pending.empty();
+        }
 
-                if (args.size() > 1) {
-                    if (args[1] == "by-name")
-                        tools::sortLevelList(&lvls, tools::Sorting::Name);
-                }
+        /**
+         * Write pending changes.
+         * @returns gdshare::Result
+        */
+        Result save() {
+            if (!local || !dirty())
+                return { true, "" };
+            auto res = local->saveX();
+            if (res.OK) pending.clear();
+            return res;
+        }
+    };
 
-                for (Level* lvl : lvls)
-                    std::cout << lvl->name() << std::endl;
-            } break;
+    void runCommand(const std::vector<std::string> & args, Session & session);
+
+    /**
+     * Search as you type. Results are narrowed down on every key press;
+     * Up/Down pick a level, Enter shows its info and Tab exports it.
+    */
+    void interactiveFind(Session & session) {
+        CCLocalLevelsX* local = session.levels();
+        const LevelIndex & index = local->index();
+
+        std::vector<uint32_t> order;
+        for (size_t ix : index.sortedByName())
+            order.push_back(static_cast<uint32_t>(ix));
+        IncrementalSearch search (local->nameSearch(), std::move(order));
+
+        std::string command;
+        std::string picked;
+        {
+            term::RawMode raw;
+            if (!raw.isOK()) {
+                std::cout << "Unable to read keys from this terminal" << std::endl;
+                return;
+            }
 
-            case h$("find"): {
-                if (args.size() < 2) {
-                    std::cout << "Usage: \"find <search-term>\"" << std::endl;
-                    return;
+            size_t selection = 0;
+            bool drawn = false;
+            // hide the cursor while redrawing
+            std::cout << "\x1b[?25l";
+
+            for (bool running = true; running;) {
+                auto & res = search.results();
+                if (selection >= res.size())
+                    selection = res.empty() ? 0 : res.size() - 1;
+
+                // the frame is always max_search + 2 lines, so going back
+                // to its top is a fixed distance
+                std::ostringstream frame;
+                if (drawn)
+                    frame << "\r\x1b[" << max_search + 1 << "A";
+                frame << "\x1b[J" << "Search: " << search.query() << "\n";
+
+                size_t first = selection >= max_search ? selection - max_search + 1 : 0;
+                for (size_t row = 0; row < max_search; row++) {
+                    size_t ix = first + row;
+                    if (ix < res.size()) {
+                        auto & rec = index.at(res[ix]);
+                        frame << (ix == selection ? " > \x1b[7m" : "   ")
+                            << index.name(res[ix]) << " (" << index.str(rec.length);
+                        if (rec.objects >= 0)
+                            frame << ", " << rec.objects << " objs";
+                        frame << ")" << (ix == selection ? "\x1b[0m" : "");
+                    }
+                    frame << "\n";
                 }
-                std::cout << "Loading levels..." << std::endl;
-
-                CCLocalLevels* local = new CCLocalLevels([](std::string s, int p) -> void {
-                    std::cout << p << "% ";
-                });
+                frame << res.size() << " results - Up/Down select, Enter info, Tab export, Esc quit";
+                std::cout << frame.str() << std::flush;
+                drawn = true;
+
+                auto in = term::readKey();
+                switch (in.key) {
+                    case term::Key::Char:
+                        search.push(in.c);
+                        selection = 0;
+                        break;
+
+                    case term::Key::Backspace:
+                        search.pop();
+                        selection = 0;
+                        break;
+
+                    case term::Key::Up:
+                        if (selection > 0) selection--;
+                        break;
+
+                    case term::Key::Down:
+                        if (selection + 1 < res.size()) selection++;
+                        break;
+
+                    case term::Key::Enter:
+                    case term::Key::Tab:
+                        if (res.empty()) break;
+                        command = in.key == term::Key::Enter ? "info" : "export";
+                        picked = index.name(res[selection]);
+                        running = false;
+                        break;
+
+                    case term::Key::Escape:
+                    case term::Key::Interrupt:
+                    case term::Key::End:
+                        running = false;
+                        break;
+
+                    default:
+                        break;
+                }
+            }
 
-                std::cout << "\n\n";
+            std::cout << "\x1b[?25h\n\n" << std::flush;
+        }
 
-                std::vector<Level*> lvls = local->getLevels();
+        if (!command.empty())
+            runCommand({ command, picked }, session);
+    }
 
-                tools::sortLevelList(&lvls, tools::Sorting::Name);
+    void runCommand(const std::vector<std::string> & args, Session & session) {
+        switch (h$(args[0].c_str())) {
+            case h$("list"): {
+                CCLocalLevelsX* local = session.levels();
 
-                std::string srch = args.at(1);
-                int found;
+                const LevelIndex & index = local->index();
 
-                for (Level* lvl : lvls) {
-                    std::string name = lvl->name();
-                    trim(name);
-                    trim(srch);
-                    lower(name);
-                    lower(srch);
-                    if (name.find(srch) != std::string::npos) {
-                        std::cout
-                            << " * " << lvl->name()
-                            << " (" << lvl->length()
-                            << ", " << lvl->objectCount()
-                            << " objs)\n";
-                        found++;
-                    }
-                }
+                std::vector<size_t> order;
+                if (args.size() > 1 && args[1] == "by-name")
+                    order = index.sortedByName();
+                else
+                    for (size_t ix = 0; ix < index.size(); ix++)
+                        order.push_back(ix);
 
-                std::cout << "\nFound " << found << " results" << std::endl;
+                for (size_t ix : order)
+                    std::cout << index.name(ix) << std::endl;
 
-                /*
+                local->flushIndex();
+            } break;
 
-                for (int i = 0; i < max_search + 1; i++)
-                    std::cout << "\n";
-                
-                std::cout << "\n\n";
+            case h$("find"): {
+                if (args.size() < 2) {
+                    if (session.interactive && term::isInteractive())
+                        interactiveFind(session);
+                    else
+                        std::cout << "Usage: \"find <search-term>\"" << std::endl;
+                    return;
+                }
+                CCLocalLevelsX* local = session.levels();
 
-                std::cout <<
-                    "Press ESC to exit searching.\n" <<
-                    "Use arrow keys to select a found result, and press ENTER to select.\n" <<
-                    "Type level name: ";
+                const LevelIndex & index = local->index();
 
-                char key;
-                int typed = 0;
-                int selection = 0;
+                std::vector<bool> matched (index.size());
+                for (auto ix : local->nameSearch().find(args.at(1)))
+                    matched[ix] = true;
                 int found = 0;
-                std::string searchs;
-                bool ignore_next = false;
-
-                while (!isBreakChar((key = _getch()))) {
-                    //if (GetAsyncKeyState(VK_CONTROL))
-                    //    continue;
-
-                    if (ignore_next) {
-                        ignore_next = false;
-                        continue;
-                    }
 
-                    int clearbuf = 40;
-                    bool hop = false;
-                    
-                    if (key == 72) {
-                        if (selection < found)
-                            selection++;
-                        hop = true;
-
-                        ignore_next = true;
+                for (size_t ix : index.sortedByName()) {
+                    if (matched[ix]) {
+                        std::cout
+                            << " * " << index.name(ix)
+                            << " (" << index.str(index.at(ix).length)
+                            << ", " << local->objectCount(ix)
+                            << " objs)\n";
+                        found++;
                     }
-                    if (key == 80) {
-                        if (selection > 0)
-                            selection--;
-                        hop = true;
+                }
 
-                        ignore_next = true;
+                // nothing contains the term as typed; fall back to the
+                // closest names, which catches typos and missing words
+                if (!found) {
+                    auto close = local->trigrams().find(args.at(1), max_search);
+                    if (!close.empty()) {
+                        std::cout << "No exact matches. Closest names:\n";
+                        for (auto & match : close)
+                            std::cout
+                                << " * " << index.name(match.level)
+                                << " (" << index.str(index.at(match.level).length)
+                                << ", " << local->objectCount(match.level)
+                                << " objs)\n";
                     }
+                }
 
-                    if (!hop) {
-                        // handle backspace
-                        if (key == 8) {
-                            if (typed <= 0) continue;
-                            std::cout << "\b \b";
-                            searchs = searchs.substr(0, searchs.size() - 1);
-                            typed--;
-                        } else {
-                            typed++;
-                            std::cout << key;
-                            searchs += key;
-                        }
-                    }
+                local->flushIndex();
 
-                    CONSOLE_SCREEN_BUFFER_INFO cbsi;
-                    GetConsoleScreenBufferInfo(console, &cbsi);
-
-                    if (!hop) {
-                        // clear output area
-                        gotoXY(0, cbsi.dwCursorPosition.Y - max_search - 5);
-                        for (int ix = 0; ix < max_search + 2; ix++)
-                            std::cout << std::string(clearbuf, ' ')
-                                    << std::string(clearbuf, '\b')
-                                    << "\n";
-
-                        // print found levels
-                        gotoXY(0, cbsi.dwCursorPosition.Y - max_search - 5);
-                        found = printSearchedLevels(lvls, searchs);
-                        gotoXY(cbsi.dwCursorPosition.X, cbsi.dwCursorPosition.Y);
-                    } else {
-                        gotoXY(0, cbsi.dwCursorPosition.Y - 5 - selection);
-                        std::cout << selection << "/" << found;
-                        gotoXY(cbsi.dwCursorPosition.X, cbsi.dwCursorPosition.Y);
-                    }
-                }   //*/
+                std::cout << "\nFound " << found << " results" << std::endl;
             } break;
 
             case h$("export"): {
@@ -257,13 +366,7 @@ namespace gdscli {
                     return;
                 }
 
-                std::cout << "Loading levels..." << std::endl;
-
-                CCLocalLevels* local = new CCLocalLevels([](std::string s, int p) -> void {
-                    std::cout << p << "% ";
-                });
-
-                std::cout << "\n\n";
+                CCLocalLevelsX* local = session.levels();
 
                 std::map<std::string, std::string> types = {
                     { "as-gmd", filetypes::GDShare },
@@ -272,12 +375,94 @@ namespace gdscli {
                 };
 
                 std::string type = filetypes::Default;
+                std::vector<CCLocalLevelsX::ExportJob> jobs;
 
-                for (int ix = 1; ix < args.size(); ix++)
+                for (size_t ix = 1; ix < args.size(); ix++)
                     if (types.find(args.at(ix)) != types.end())
                         type = types.at(args.at(ix));
                     else
-                        std::cout << local->exportLevel(args.at(ix), "", type).info << std::endl;
+                        jobs.push_back({ args.at(ix), session.dir, type });
+
+                local->exportLevels(jobs, [](size_t, const Result & res) -> void {
+                    std::cout << res.info << std::endl;
+                });
+            } break;
+
+            case h$("export-all"): {
+                if (args.size() < 2) {
+                    std::cout << "\nUsage: \"export-all <path/to/backup.gdsa> [name filter]\"\n\n"
+                        << "Backs up every level, or every level whose name contains the filter, into one file.\n"
+                        << "Use \"extract\" to get single levels back out.\n\n";
+                    return;
+                }
+
+                CCLocalLevelsX* local = session.levels();
+
+                std::cout << local->exportAll(session.resolve(args.at(1)), args.size() > 2 ? args.at(2) : "").info << std::endl;
+            } break;
+
+            case h$("extract"): {
+                if (args.size() < 2) {
+                    std::cout << "\nUsage: \"extract <path/to/backup.gdsa> <level 1 name> <level 2 name> ...\"\n\n"
+                        << "Note: Without level names, lists the levels in the backup.\n\n"
+                        << "Note: You can extract to a specified format with as-<format>, like with \"export\".\n\n";
+                    return;
+                }
+
+                LevelArchive archive;
+                auto res = archive.open(args.at(1));
+                if (!res.OK) {
+                    std::cout << res.info << std::endl;
+                    return;
+                }
+
+                if (args.size() < 3) {
+                    std::cout << archive.entries().size() << " levels in " << args.at(1) << ":\n";
+                    for (auto & entry : archive.entries())
+                        std::cout << " * " << entry.name << "\n";
+                    std::cout << std::endl;
+                    return;
+                }
+
+                std::map<std::string, std::string> types = {
+                    { "as-gmd", filetypes::GDShare },
+                    { "as-gmd2", filetypes::GDShare2 },
+                    { "as-lvl", filetypes::LvlShare }
+                };
+
+                std::string type = filetypes::Default;
+                for (size_t ix = 2; ix < args.size(); ix++) {
+                    if (types.find(args.at(ix)) != types.end()) {
+                        type = types.at(args.at(ix));
+                        continue;
+                    }
+
+                    long long found = archive.find(args.at(ix));
+                    if (found < 0) {
+                        std::cout << "Level \"" << args.at(ix) << "\" not found!\n";
+                        continue;
+                    }
+
+                    std::string text;
+                    res = archive.read(found, text);
+                    if (!res.OK) {
+                        std::cout << res.info << std::endl;
+                        continue;
+                    }
+
+                    rapidxml::xml_document<> doc;
+                    try {
+                        doc.parse<rapidxml::parse_no_data_nodes>(text.data());
+                    } catch (rapidxml::parse_error &) {}
+
+                    if (!doc.first_node("d")) {
+                        std::cout << "\"" << args.at(ix) << "\" is corrupted\n";
+                        continue;
+                    }
+
+                    Level lvl (doc.first_node("d"));
+                    std::cout << levelfile::exportTo(&lvl, "", type).info << std::endl;
+                }
             } break;
 
             case h$("import"): {
@@ -288,20 +473,27 @@ namespace gdscli {
                     return;
                 }
 
-                std::cout << "Loading levels..." << std::endl;
-
-                CCLocalLevels* local = new CCLocalLevels([](std::string s, int p) -> void {
-                    std::cout << p << "% ";
-                });
+                CCLocalLevelsX* local = session.levels();
 
-                std::cout << "\n\n";
+                std::vector<std::string> paths;
+                for (size_t ix = 1; ix < args.size(); ix++)
+                    paths.push_back(session.resolve(args.at(ix)));
+                auto results = local->importLevels(paths);
+                for (size_t ix = 0; ix < paths.size(); ix++) {
+                    std::cout << results[ix] << std::endl;
+                    if (results[ix].OK)
+                        session.pending.push_back(std::filesystem::absolute(paths[ix]).string());
+                }
 
-                for (int ix = 1; ix < args.size(); ix++)
-                    std::cout << local->importLevel(args.at(ix)) << std::endl;
+                if (!session.autosave) {
+                    if (session.dirty())
+                        std::cout << "Queued for the next save" << std::endl;
+                    break;
+                }
                 
                 std::cout << "Saving..." << std::endl;
                 
-                auto res = local->save();
+                auto res = session.save();
 
                 if (res.OK)
                     std::cout << "Saved!" << std::endl;
@@ -319,47 +511,67 @@ namespace gdscli {
                     return;
                 }
 
-                std::cout << "Loading levels..." << std::endl;
+                CCLocalLevelsX* local = session.levels();
 
-                CCLocalLevels* local = new CCLocalLevels([](std::string s, int p) -> void {
-                    std::cout << p << "% ";
-                });
+                auto printInfo = [](const LevelIndex & index, const LevelIndex::Record & rec, int objects) -> void {
+                    std::cout
+                        << "Name\t\t" << index.str(rec.name) << "\n"
+                        << "Creator\t\t" << index.str(rec.creator) << "\n"
+                        << "Description\t" << index.str(rec.description) << "\n"
+                        << "Object count\t" << objects << "\n"
+                        << "Editor time\t" << rec.editorTime / 3600 << "h\n"
+                        << "Song\t\t" << index.str(rec.song) << "\n"
+                        << "Version\t\t" << rec.version << "\n"
+                        << "Attempts\t" << rec.attempts << "\n"
+                        << "Length\t\t" << index.str(rec.length)
+                        << "\n\n";
+                };
 
-                std::cout << "\n\n";
+                for (size_t ix = 1; ix < args.size(); ix++) {
+                    // without a cached index, only the requested level gets parsed
+                    if (!local->hasIndex()) {
+                        Level* lvl = local->getLevel(args.at(ix));
 
-                for (int ix = 1; ix < args.size(); ix++) {
-                    Level* lvl = local->getLevel(args.at(ix));
+                        if (lvl == nullptr) {
+                            std::cout << "Level \"" << args.at(ix) << "\" not found!\n";
+                            continue;
+                        }
 
-                    if (lvl == nullptr) {
-                        std::cout << "Level \"" << args.at(ix) << "\" not found!\n";
+                        LevelIndex single = LevelIndex::build({ lvl });
+                        printInfo(single, single.at(0), local->objectCount(lvl));
                         continue;
                     }
 
-                    std::string etime = lvl->key(Level::Keys["editor-time"]);
-                    if (etime == "") etime = "0";
+                    long long lvl = local->index().find(args.at(ix));
 
-                    std::cout
-                        << "Name\t\t" << lvl->name() << "\n"
-                        << "Creator\t\t" << lvl->key(Level::Keys["creator"]) << "\n"
-                        << "Description\t" << lvl->description() << "\n"
-                        << "Object count\t" << lvl->objectCount() << "\n"
-                        << "Editor time\t" << std::stoi(etime) / 3600 << "h\n"
-                        << "Song\t\t" << lvl->song() << "\n"
-                        << "Version\t\t" << lvl->key(Level::Keys["version"]) << "\n"
-                        << "Attempts\t" << lvl->key(Level::Keys["attempts"]) << "\n"
-                        << "Length\t\t" << lvl->length()
-                        << "\n\n";
+                    if (lvl < 0) {
+                        std::cout << "Level \"" << args.at(ix) << "\" not found!\n";
+                        continue;
+                    }
+
+                    printInfo(local->index(), local->index().at(lvl), local->objectCount(lvl));
                 }
+
+                local->flushIndex();
+            } break;
+
+            case h$("bench"): {
+                benchBackends(args.size() > 1 ? args.at(1) : CCLocalLevelsX::defaultPath());
             } break;
 
             case h$("help"): {
                 std::cout << "GDShare-CLI " << version << "\n\n"
                 << "Commands:\n"
                 << "export\t\tExport level(s)\n"
+                << "export-all\tBack up levels into one file\n"
+                << "extract\t\tGet level(s) out of a backup\n"
                 << "import\t\tImport level(s)\n"
                 << "list\t\tList levels\n"
                 << "find\t\tFind a level\n"
-                << "info\t\tView level info\n\n"
+                << "info\t\tView level info\n"
+                << "bench\t\tCompare compression backends on a save\n"
+                << "batch\t\tRun many commands with one load and save\n"
+                << "serve\t\tKeep the save loaded for other commands\n\n"
                 << "For support, contact HJfod#1795 on Discord\n\n";
             } break;
 
@@ -368,4 +580,286 @@ namespace gdscli {
                 "Use \"gdshare.exe help\" to get a list of commands.\n";
         }
     }
+
+    // how long serve waits after the last request before saving
+    static constexpr int save_delay_ms = 2000;
+    // how long serve waits for a connected client to send its request
+    static constexpr int request_timeout_ms = 5000;
+
+    /**
+     * Where serve listens: GDSHARE_SOCKET if set, else gdshare.sock in a
+     * directory only this user can access, see ipc::privateDir.
+     * @returns The path, or "" if there's no safe default
+    */
+    static std::string socketPath() {
+        if (const char* path = std::getenv("GDSHARE_SOCKET"))
+            if (*path) return path;
+        auto dir = ipc::privateDir();
+        if (dir.empty()) return "";
+        return (std::filesystem::path(dir) / "gdshare.sock").string();
+    }
+
+    // commands a running server answers
+    static bool isServed(const std::string & cmd) {
+        switch (h$(cmd.c_str())) {
+            case h$("list"): case h$("find"): case h$("info"):
+            case h$("export"): case h$("import"): case h$("export-all"):
+            case h$("stop"):
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    /**
+     * Hand a command to a running server.
+     * @returns false if no server for this save is running, so the
+     * command should run locally
+    */
+    static bool forward(const std::vector<std::string> & args) {
+        auto sock = ipc::connect(socketPath());
+        // only hand commands to a server run by the same user
+        if (!sock.isOpen() || !sock.peerIsSelf())
+            return false;
+
+        std::error_code err;
+        ipc::Message req { CCLocalLevelsX::defaultPath(), std::filesystem::current_path(err).string() };
+        req.insert(req.end(), args.begin(), args.end());
+
+        ipc::Message res;
+        if (!sock.send(req) || !sock.receive(res) || res.size() < 2 || res[0] != "ok")
+            return false;
+
+        std::cout << res[1] << std::flush;
+        return true;
+    }
+
+    // last write time and size, to notice the save changing under us
+    static std::pair<std::filesystem::file_time_type, uintmax_t> fileStamp(const std::string & path) {
+        std::error_code err;
+        auto time = std::filesystem::last_write_time(path, err);
+        auto size = std::filesystem::file_size(path, err);
+        return { time, err ? 0 : size };
+    }
+
+    /**
+     * Keep the save decoded in memory and answer commands from other
+     * gdshare processes over a local socket. The save is reloaded when it
+     * changes on disk, and imports are saved together once requests stop
+     * coming in for a moment.
+    */
+    void serve(const std::string & path) {
+        if (path.empty()) {
+            std::cout << "No private directory for the socket, set GDSHARE_SOCKET" << std::endl;
+            return;
+        }
+
+        ipc::Listener listener;
+        auto res = listener.listen(path);
+        if (!res.OK) {
+            std::cout << res.info << std::endl;
+            return;
+        }
+
+        Session session;
+        session.autosave = false;
+        session.interactive = false;
+        try {
+            session.levels();
+        } catch (std::exception & e) {
+            std::cout << "Error: " << e.what() << std::endl;
+            return;
+        }
+        auto save = session.local->path;
+        auto stamp = fileStamp(save);
+
+        std::cout << "Listening on " << path << " (\"gdshare.exe stop\" to quit)" << std::endl;
+
+        auto flush = [&]() -> void {
+            if (!session.dirty()) return;
+            auto res = session.save();
+            std::cout << (res.OK ? "Saved" : "Error saving: " + res.info) << std::endl;
+            stamp = fileStamp(save);
+        };
+
+        for (bool running = true; running;) {
+            auto client = listener.accept(session.dirty() ? save_delay_ms : -1);
+            if (!client.isOpen()) {
+                flush();
+                continue;
+            }
+
+            // other users could otherwise make this user's save import
+            // or export files
+            if (!client.peerIsSelf())
+                continue;
+
+            ipc::Message req;
+            client.timeout(request_timeout_ms);
+            if (!client.receive(req) || req.size() < 3 || !std::filesystem::path(req[1]).is_absolute())
+                continue;
+
+            if (req[0] != save) {
+                client.send({ "skip", "" });
+                continue;
+            }
+
+            std::vector<std::string> args (req.begin() + 2, req.end());
+            if (!isServed(args[0])) {
+                client.send({ "skip", "" });
+                continue;
+            }
+
+            std::ostringstream out;
+            auto console = std::cout.rdbuf(out.rdbuf());
+            // paths in the command are relative to the client
+            session.dir = req[1];
+
+            try {
+                // GD (or anything else) wrote the save: start over from
+                // the new file, keeping imports that weren't saved yet
+                if (fileStamp(save) != stamp) {
+                    auto res = session.local->initX(save);
+                    stamp = fileStamp(save);
+                    if (res.OK && session.dirty()) {
+                        auto pending = std::move(session.pending);
+                        session.pending.clear();
+                        auto results = session.local->importLevels(pending);
+                        for (size_t ix = 0; ix < pending.size(); ix++)
+                            if (results[ix].OK)
+                                session.pending.push_back(pending[ix]);
+                    }
+                    if (!res.OK)
+                        std::cout << "Unable to reload the save: " << res.info << std::endl;
+                }
+
+                if (args[0] == "stop") {
+                    flush();
+                    std::cout << "Server stopped" << std::endl;
+                    running = false;
+                } else
+                    runCommand(args, session);
+            } catch (std::exception & e) {
+                std::cout << "Error: " << e.what() << std::endl;
+            }
+
+            session.dir.clear();
+            std::cout.rdbuf(console);
+            client.send({ "ok", out.str() });
+        }
+    }
+
+    /**
+     * Split a command line into arguments. Whitespace separates arguments
+     * unless it's inside double quotes.
+    */
+    static std::vector<std::string> splitArgs(const std::string & line) {
+        std::vector<std::string> args;
+        std::string arg;
+        bool quoted = false, any = false;
+        for (char c : line) {
+            if (c == '"') {
+                quoted = !quoted;
+                any = true;
+            } else if (!quoted && std::isspace(static_cast<unsigned char>(c))) {
+                if (any) args.push_back(arg);
+                arg.clear();
+                any = false;
+            } else {
+                arg += c;
+                any = true;
+            }
+        }
+        if (any) args.push_back(arg);
+        return args;
+    }
+
+    /**
+     * Run a script of commands, one per line, against a single loaded
+     * save. Changes are saved once at the end. Empty lines and lines
+     * starting with # are skipped.
+     * @param path The script, or "-" for standard input
+    */
+    void batch(const std::string & path) {
+        std::ifstream file;
+        if (path != "-") {
+            file.open(path);
+            if (!file.is_open()) {
+                std::cout << "Unable to open " << path << std::endl;
+                return;
+            }
+        }
+        std::istream & in = path == "-" ? std::cin : file;
+
+        Session session;
+        session.autosave = false;
+        session.interactive = false;
+
+        std::string line;
+        for (size_t num = 1; std::getline(in, line); num++) {
+            auto args = splitArgs(line);
+            if (args.empty() || args[0][0] == '#')
+                continue;
+
+            switch (h$(args[0].c_str())) {
+                case h$("serve"): case h$("stop"): case h$("batch"):
+                    std::cout << "Line " << num << ": \"" << args[0] << "\" can't be used in a batch" << std::endl;
+                    continue;
+            }
+
+            try {
+                runCommand(args, session);
+            } catch (std::exception & e) {
+                std::cout << "Line " << num << ": " << e.what() << std::endl;
+            }
+        }
+
+        if (session.dirty()) {
+            std::cout << "Saving..." << std::endl;
+            auto res = session.save();
+            if (res.OK)
+                std::cout << "Saved!" << std::endl;
+            else
+                std::cout << "Error saving: " << res.info << std::endl;
+        }
+    }
+
+    void processInput(int ac, char* av[]) {
+        if (ac < 2) {
+            std::cout << "Use \"./gdshare.exe help\" for help." << std::endl;
+            return;
+        }
+
+        std::vector<std::string> args;
+        for (int i = 0; i < ac; i++)
+            args.assign(av + 1, av + ac);
+
+        if (args[0] == "serve") {
+            serve(args.size() > 1 ? args[1] : socketPath());
+            return;
+        }
+
+        if (args[0] == "batch") {
+            if (args.size() < 2)
+                std::cout << "\nUsage: \"batch <path/to/script.txt>\" or \"batch -\" to read from input\n\n"
+                    << "Runs one command per line against the save, which is only loaded and saved once.\n\n";
+            else
+                batch(args[1]);
+            return;
+        }
+
+        // interactive find needs this terminal, so it always runs here on
+        // the save as it is on disk, and so do the info and export it ends
+        // with
+        if (isServed(args[0]) && !(args[0] == "find" && args.size() < 2) && forward(args))
+            return;
+
+        if (args[0] == "stop") {
+            std::cout << "No server is running" << std::endl;
+            return;
+        }
+
+        Session session;
+        runCommand(args, session);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,1381 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <future>
+#include <deque>
+#include <memory>
+#include <zlib.h>
+#include "gdshare.hpp"
+#include "gdshare-pool.hpp"
+#include "gdshare-backend.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define GDSHARE_X86
+    #include <immintrin.h>
+    #ifdef _MSC_VER
+        #include <intrin.h>
+        // MSVC allows intrinsics for any ISA without opting in
+        #define GDSHARE_TARGET(isa)
+    #else
+        #include <cpuid.h>
+        #define GDSHARE_TARGET(isa) __attribute__((target(isa)))
+    #endif
+#else
+    #define GDSHARE_TARGET(isa)
+#endif
+
+namespace gdshare {
+    namespace codec {
+        /**
+         * Size of the slices the streaming codecs work in. Every
+         * intermediate buffer is bounded by a small multiple of this.
+        */
+        static constexpr size_t ChunkSize = 0x10000;
+
+        /**
+         * XOR key GD uses for CC*.dat files.
+        */
+        static constexpr int SaveKey = 11;
+
+        namespace detail {
+            /**
+             * Base64 reverse lookup. Accepts both the URL-safe alphabet GD
+             * writes and the standard one, -1 for anything else.
+            */
+            struct Base64Table {
+                int8_t v[256];
+
+                constexpr Base64Table() : v() {
+                    for (int i = 0; i < 256; i++) v[i] = -1;
+                    for (int i = 0; i < 26; i++) {
+                        v['A' + i] = static_cast<int8_t>(i);
+                        v['a' + i] = static_cast<int8_t>(26 + i);
+                    }
+                    for (int i = 0; i < 10; i++)
+                        v['0' + i] = static_cast<int8_t>(52 + i);
+                    v['-'] = v['+'] = 62;
+                    v['_'] = v['/'] = 63;
+                }
+            };
+
+            inline constexpr Base64Table Base64Lookup {};
+        }
+
+        /**
+         * Instruction sets the codec kernels have implementations for.
+        */
+        enum class Isa {
+            Scalar,
+            SSE2,
+            SSSE3,
+            AVX2,
+            AVX512
+        };
+
+        namespace detail {
+            #if defined(GDSHARE_X86)
+            inline void cpuid(int leaf, int sub, unsigned int regs[4]) {
+                #ifdef _MSC_VER
+                    __cpuidex(reinterpret_cast<int*>(regs), leaf, sub);
+                #else
+                    __cpuid_count(leaf, sub, regs[0], regs[1], regs[2], regs[3]);
+                #endif
+            }
+
+            inline uint64_t xgetbv() {
+                #ifdef _MSC_VER
+                    return _xgetbv(0);
+                #else
+                    unsigned int lo, hi;
+                    __asm__ volatile ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+                    return (static_cast<uint64_t>(hi) << 32) | lo;
+                #endif
+            }
+
+            inline Isa detectIsa() {
+                unsigned int r[4] = { 0 };
+                cpuid(0, 0, r);
+                int maxLeaf = static_cast<int>(r[0]);
+
+                cpuid(1, 0, r);
+                bool sse2 = r[3] & (1u << 26);
+                bool ssse3 = r[2] & (1u << 9);
+                bool osxsave = r[2] & (1u << 27);
+                bool avx = r[2] & (1u << 28);
+
+                // the OS has to save the wide registers on context switches too
+                uint64_t xcr0 = osxsave ? xgetbv() : 0;
+                bool ymm = (xcr0 & 0x6) == 0x6;
+                bool zmm = (xcr0 & 0xe6) == 0xe6;
+
+                bool avx2 = false, avx512 = false;
+                if (maxLeaf >= 7) {
+                    cpuid(7, 0, r);
+                    avx2 = r[1] & (1u << 5);
+                    // F + BW
+                    avx512 = (r[1] & (1u << 16)) && (r[1] & (1u << 30));
+                }
+
+                if (avx512 && avx && zmm) return Isa::AVX512;
+                if (avx2 && avx && ymm) return Isa::AVX2;
+                if (ssse3) return Isa::SSSE3;
+                if (sse2) return Isa::SSE2;
+                return Isa::Scalar;
+            }
+            #else
+            inline Isa detectIsa() {
+                return Isa::Scalar;
+            }
+            #endif
+        }
+
+        /**
+         * Get the best instruction set supported by this CPU. Detected
+         * once with CPUID; can be capped by setting GDSHARE_ISA to
+         * scalar, sse2, ssse3 or avx2 in the environment.
+         * @returns The instruction set the dispatched kernels use
+        */
+        inline Isa bestIsa() {
+            static const Isa isa = []() -> Isa {
+                Isa res = detail::detectIsa();
+                if (const char* cap = std::getenv("GDSHARE_ISA")) {
+                    Isa max = Isa::AVX512;
+                    if (!std::strcmp(cap, "scalar")) max = Isa::Scalar;
+                    else if (!std::strcmp(cap, "sse2")) max = Isa::SSE2;
+                    else if (!std::strcmp(cap, "ssse3")) max = Isa::SSSE3;
+                    else if (!std::strcmp(cap, "avx2")) max = Isa::AVX2;
+                    res = std::min(res, max);
+                }
+                return res;
+            }();
+            return isa;
+        }
+
+        namespace xorx {
+            /**
+             * Reference implementation. dst may equal src.
+             * @param dst Output buffer, at least size bytes
+             * @param src Input buffer
+             * @param size Amount of bytes to process
+             * @param key The key to use
+            */
+            inline void scalar(uint8_t* dst, const uint8_t* src, size_t size, uint8_t key) {
+                for (size_t i = 0; i < size; i++)
+                    dst[i] = src[i] ^ key;
+            }
+
+            #if defined(GDSHARE_X86)
+            GDSHARE_TARGET("sse2")
+            inline void sse2(uint8_t* dst, const uint8_t* src, size_t size, uint8_t key) {
+                const __m128i k = _mm_set1_epi8(static_cast<char>(key));
+                size_t i = 0;
+                for (; i + 16 <= size; i += 16) {
+                    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_xor_si128(v, k));
+                }
+                scalar(dst + i, src + i, size - i, key);
+            }
+
+            GDSHARE_TARGET("avx2")
+            inline void avx2(uint8_t* dst, const uint8_t* src, size_t size, uint8_t key) {
+                const __m256i k = _mm256_set1_epi8(static_cast<char>(key));
+                size_t i = 0;
+                for (; i + 64 <= size; i += 64) {
+                    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+                    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 32));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_xor_si256(a, k));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 32), _mm256_xor_si256(b, k));
+                }
+                for (; i + 32 <= size; i += 32) {
+                    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_xor_si256(a, k));
+                }
+                sse2(dst + i, src + i, size - i, key);
+            }
+
+            GDSHARE_TARGET("avx512f,avx512bw")
+            inline void avx512(uint8_t* dst, const uint8_t* src, size_t size, uint8_t key) {
+                const __m512i k = _mm512_set1_epi8(static_cast<char>(key));
+                size_t i = 0;
+                for (; i + 64 <= size; i += 64) {
+                    __m512i v = _mm512_loadu_si512(src + i);
+                    _mm512_storeu_si512(dst + i, _mm512_xor_si512(v, k));
+                }
+                if (i < size) {
+                    // masked tail instead of falling back to narrower loops
+                    __mmask64 m = _cvtu64_mask64(~0ull >> (64 - (size - i)));
+                    __m512i v = _mm512_maskz_loadu_epi8(m, src + i);
+                    _mm512_mask_storeu_epi8(dst + i, m, _mm512_xor_si512(v, k));
+                }
+            }
+            #endif
+
+            /**
+             * Get the kernel for an instruction set. Falls back to the
+             * next narrower one if the set has no XOR kernel.
+            */
+            inline void (*kernel(Isa isa))(uint8_t*, const uint8_t*, size_t, uint8_t) {
+                #if defined(GDSHARE_X86)
+                switch (isa) {
+                    case Isa::AVX512: return avx512;
+                    case Isa::AVX2: return avx2;
+                    case Isa::SSSE3: case Isa::SSE2: return sse2;
+                    default: break;
+                }
+                #endif
+                return scalar;
+            }
+        }
+
+        namespace countx {
+            /**
+             * Reference implementation.
+             * @param data The buffer to search
+             * @param size Size of the buffer in bytes
+             * @param c The byte to count
+             * @returns Amount of times c occurs in the buffer
+            */
+            inline size_t scalar(const uint8_t* data, size_t size, uint8_t c) {
+                size_t res = 0;
+                for (size_t i = 0; i < size; i++)
+                    res += data[i] == c;
+                return res;
+            }
+
+            #if defined(GDSHARE_X86)
+            GDSHARE_TARGET("sse2")
+            inline size_t sse2(const uint8_t* data, size_t size, uint8_t c) {
+                const __m128i k = _mm_set1_epi8(static_cast<char>(c));
+                const __m128i zero = _mm_setzero_si128();
+                __m128i total = _mm_setzero_si128();
+                size_t i = 0;
+                while (i + 16 <= size) {
+                    // per-byte counters, widened before they can overflow
+                    __m128i acc = _mm_setzero_si128();
+                    size_t end = std::min(size - 15, i + 255 * 16);
+                    for (; i < end; i += 16) {
+                        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+                        acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(v, k));
+                    }
+                    total = _mm_add_epi64(total, _mm_sad_epu8(acc, zero));
+                }
+                return static_cast<size_t>(_mm_cvtsi128_si64(total)) +
+                    static_cast<size_t>(_mm_cvtsi128_si64(_mm_unpackhi_epi64(total, total))) +
+                    scalar(data + i, size - i, c);
+            }
+
+            GDSHARE_TARGET("avx2")
+            inline size_t avx2(const uint8_t* data, size_t size, uint8_t c) {
+                const __m256i k = _mm256_set1_epi8(static_cast<char>(c));
+                const __m256i zero = _mm256_setzero_si256();
+                __m256i total = _mm256_setzero_si256();
+                size_t i = 0;
+                while (i + 32 <= size) {
+                    __m256i acc = _mm256_setzero_si256();
+                    size_t end = std::min(size - 31, i + 255 * 32);
+                    for (; i < end; i += 32) {
+                        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+                        acc = _mm256_sub_epi8(acc, _mm256_cmpeq_epi8(v, k));
+                    }
+                    total = _mm256_add_epi64(total, _mm256_sad_epu8(acc, zero));
+                }
+                __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(total), _mm256_extracti128_si256(total, 1));
+                return static_cast<size_t>(_mm_cvtsi128_si64(sum)) +
+                    static_cast<size_t>(_mm_cvtsi128_si64(_mm_unpackhi_epi64(sum, sum))) +
+                    sse2(data + i, size - i, c);
+            }
+
+            GDSHARE_TARGET("avx512f,avx512bw,popcnt")
+            inline size_t avx512(const uint8_t* data, size_t size, uint8_t c) {
+                const __m512i k = _mm512_set1_epi8(static_cast<char>(c));
+                size_t res = 0, i = 0;
+                for (; i + 64 <= size; i += 64)
+                    res += _mm_popcnt_u64(_cvtmask64_u64(_mm512_cmpeq_epi8_mask(_mm512_loadu_si512(data + i), k)));
+                if (i < size) {
+                    __mmask64 m = _cvtu64_mask64(~0ull >> (64 - (size - i)));
+                    __m512i v = _mm512_maskz_loadu_epi8(m, data + i);
+                    res += _mm_popcnt_u64(_cvtmask64_u64(_mm512_mask_cmpeq_epi8_mask(m, v, k)));
+                }
+                return res;
+            }
+            #endif
+
+            /**
+             * Get the kernel for an instruction set.
+            */
+            inline size_t (*kernel(Isa isa))(const uint8_t*, size_t, uint8_t) {
+                #if defined(GDSHARE_X86)
+                switch (isa) {
+                    case Isa::AVX512: return avx512;
+                    case Isa::AVX2: return avx2;
+                    case Isa::SSSE3: case Isa::SSE2: return sse2;
+                    default: break;
+                }
+                #endif
+                return scalar;
+            }
+        }
+
+        /**
+         * Count the occurrences of a byte with the fastest kernel this CPU has.
+         * @param data The buffer to search
+         * @param size Size of the buffer in bytes
+         * @param c The byte to count
+        */
+        inline size_t countByte(const uint8_t* data, size_t size, uint8_t c) {
+            static const auto fn = countx::kernel(bestIsa());
+            return fn(data, size, c);
+        }
+
+        /**
+         * XOR a buffer into another with the fastest kernel this CPU has.
+         * @param dst Output buffer, at least size bytes. May equal src.
+         * @param src Input buffer
+         * @param size Amount of bytes to process
+         * @param key The key to use
+        */
+        inline void xorInto(uint8_t* dst, const uint8_t* src, size_t size, int key) {
+            static const auto fn = xorx::kernel(bestIsa());
+            fn(dst, src, size, static_cast<uint8_t>(key));
+        }
+
+        /**
+         * XOR a caller-provided buffer in place.
+         * @param data The buffer
+         * @param size Size of the buffer in bytes
+         * @param key The key to use
+        */
+        inline void xorInPlace(uint8_t* data, size_t size, int key) {
+            xorInto(data, data, size, key);
+        }
+
+        /**
+         * Vectorized drop-in for encoder::XOR and decoder::XORX.
+         * @param data The data to encode / decode
+         * @param key The key to use
+        */
+        inline std::vector<uint8_t> XOR(const std::vector<uint8_t> & data, int key) {
+            std::vector<uint8_t> res (data.size());
+            xorInto(res.data(), data.data(), data.size(), key);
+            return res;
+        }
+
+        namespace base64x {
+            /**
+             * GD's URL-safe Base64 alphabet.
+            */
+            static constexpr const char* Alphabet =
+                "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+            /**
+             * Size of the Base64 encoding of some data.
+             * @param size Size of the data in bytes
+             * @param pad Whether the output is padded with '='
+            */
+            inline constexpr size_t encodedSize(size_t size, bool pad = true) {
+                return pad ? (size + 2) / 3 * 4 : (size * 4 + 2) / 3;
+            }
+
+            /**
+             * Upper bound for the decoded size of some Base64 data.
+             * @param size Size of the encoded data in bytes
+            */
+            inline constexpr size_t decodedSize(size_t size) {
+                return size / 4 * 3 + 2;
+            }
+
+            /**
+             * Reference encoder for whole 3-byte groups.
+             * @returns Amount of input bytes consumed
+            */
+            inline size_t encodeScalar(const uint8_t* src, size_t size, char* dst) {
+                size_t i = 0;
+                for (; i + 3 <= size; i += 3, dst += 4) {
+                    uint32_t v = (src[i] << 16) | (src[i + 1] << 8) | src[i + 2];
+                    dst[0] = Alphabet[v >> 18];
+                    dst[1] = Alphabet[(v >> 12) & 63];
+                    dst[2] = Alphabet[(v >> 6) & 63];
+                    dst[3] = Alphabet[v & 63];
+                }
+                return i;
+            }
+
+            /**
+             * Reference decoder. Decodes whole quads for as long as they
+             * contain only alphabet characters.
+             * @param consumed Receives the amount of input bytes consumed
+             * @returns Amount of bytes written
+            */
+            inline size_t decodeScalar(const uint8_t* src, size_t size, uint8_t* dst, size_t cap, size_t & consumed) {
+                const auto & lut = detail::Base64Lookup.v;
+                size_t i = 0, o = 0;
+                for (; i + 4 <= size && o + 3 <= cap; i += 4, o += 3) {
+                    int a = lut[src[i]], b = lut[src[i + 1]], c = lut[src[i + 2]], d = lut[src[i + 3]];
+                    if ((a | b | c | d) < 0) break;
+                    uint32_t v = (a << 18) | (b << 12) | (c << 6) | d;
+                    dst[o] = static_cast<uint8_t>(v >> 16);
+                    dst[o + 1] = static_cast<uint8_t>(v >> 8);
+                    dst[o + 2] = static_cast<uint8_t>(v);
+                }
+                consumed = i;
+                return o;
+            }
+
+            #if defined(GDSHARE_X86)
+            namespace simd {
+                // all-ones for bytes in [lo, hi]
+                GDSHARE_TARGET("sse2")
+                inline __m128i range(__m128i in, char lo, char hi) {
+                    return _mm_and_si128(
+                        _mm_cmpgt_epi8(in, _mm_set1_epi8(lo - 1)),
+                        _mm_cmplt_epi8(in, _mm_set1_epi8(hi + 1))
+                    );
+                }
+
+                GDSHARE_TARGET("avx2")
+                inline __m256i range(__m256i in, char lo, char hi) {
+                    return _mm256_and_si256(
+                        _mm256_cmpgt_epi8(in, _mm256_set1_epi8(lo - 1)),
+                        _mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), in)
+                    );
+                }
+
+                // 16 ASCII bytes -> 16 sextets, all-ones in bad for anything outside the alphabet
+                GDSHARE_TARGET("ssse3")
+                inline __m128i lookup(__m128i in, __m128i & bad) {
+                    __m128i upper = range(in, 'A', 'Z');
+                    __m128i lower = range(in, 'a', 'z');
+                    __m128i digit = range(in, '0', '9');
+                    __m128i c62 = _mm_or_si128(
+                        _mm_cmpeq_epi8(in, _mm_set1_epi8('-')), _mm_cmpeq_epi8(in, _mm_set1_epi8('+')));
+                    __m128i c63 = _mm_or_si128(
+                        _mm_cmpeq_epi8(in, _mm_set1_epi8('_')), _mm_cmpeq_epi8(in, _mm_set1_epi8('/')));
+
+                    __m128i shift = _mm_or_si128(
+                        _mm_or_si128(
+                            _mm_and_si128(upper, _mm_set1_epi8(-65)),
+                            _mm_and_si128(lower, _mm_set1_epi8(-71))),
+                        _mm_or_si128(
+                            _mm_and_si128(digit, _mm_set1_epi8(4)),
+                            _mm_or_si128(
+                                _mm_and_si128(c62, _mm_set1_epi8(62)),
+                                _mm_and_si128(c63, _mm_set1_epi8(63)))));
+
+                    __m128i valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, _mm_or_si128(c62, c63)));
+                    bad = _mm_cmpeq_epi8(valid, _mm_setzero_si128());
+
+                    // the symbol classes map straight to their value, not offset from the byte
+                    __m128i sym = _mm_or_si128(c62, c63);
+                    return _mm_or_si128(
+                        _mm_andnot_si128(sym, _mm_add_epi8(in, shift)),
+                        _mm_and_si128(sym, shift));
+                }
+
+                // 32-byte version of lookup()
+                GDSHARE_TARGET("avx2")
+                inline __m256i lookup(__m256i in, __m256i & bad) {
+                    __m256i upper = range(in, 'A', 'Z');
+                    __m256i lower = range(in, 'a', 'z');
+                    __m256i digit = range(in, '0', '9');
+                    __m256i c62 = _mm256_or_si256(
+                        _mm256_cmpeq_epi8(in, _mm256_set1_epi8('-')), _mm256_cmpeq_epi8(in, _mm256_set1_epi8('+')));
+                    __m256i c63 = _mm256_or_si256(
+                        _mm256_cmpeq_epi8(in, _mm256_set1_epi8('_')), _mm256_cmpeq_epi8(in, _mm256_set1_epi8('/')));
+
+                    __m256i shift = _mm256_or_si256(
+                        _mm256_or_si256(
+                            _mm256_and_si256(upper, _mm256_set1_epi8(-65)),
+                            _mm256_and_si256(lower, _mm256_set1_epi8(-71))),
+                        _mm256_and_si256(digit, _mm256_set1_epi8(4)));
+
+                    __m256i sym = _mm256_or_si256(c62, c63);
+                    __m256i valid = _mm256_or_si256(_mm256_or_si256(upper, lower), _mm256_or_si256(digit, sym));
+                    bad = _mm256_cmpeq_epi8(valid, _mm256_setzero_si256());
+
+                    return _mm256_or_si256(
+                        _mm256_andnot_si256(sym, _mm256_add_epi8(in, shift)),
+                        _mm256_or_si256(
+                            _mm256_and_si256(c62, _mm256_set1_epi8(62)),
+                            _mm256_and_si256(c63, _mm256_set1_epi8(63))));
+                }
+
+                // 16 sextets -> 12 bytes in the low part of the register
+                GDSHARE_TARGET("ssse3")
+                inline __m128i pack(__m128i v) {
+                    v = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));
+                    v = _mm_madd_epi16(v, _mm_set1_epi32(0x00011000));
+                    return _mm_shuffle_epi8(v, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+                }
+
+                // 12 bytes -> 16 sextets
+                GDSHARE_TARGET("ssse3")
+                inline __m128i unpack(__m128i in) {
+                    in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+                    __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+                    __m128i t1 = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+                    return _mm_or_si128(t0, t1);
+                }
+
+                // 16 sextets -> URL-safe ASCII
+                GDSHARE_TARGET("ssse3")
+                inline __m128i ascii(__m128i idx) {
+                    __m128i cls = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+                    cls = _mm_or_si128(cls, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), idx), _mm_set1_epi8(13)));
+                    const __m128i shift = _mm_setr_epi8(71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -17, 32, 65, 0, 0);
+                    return _mm_add_epi8(_mm_shuffle_epi8(shift, cls), idx);
+                }
+            }
+
+            GDSHARE_TARGET("ssse3")
+            inline size_t encodeSSSE3(const uint8_t* src, size_t size, char* dst) {
+                size_t i = 0;
+                // loads are 16 bytes wide but only 12 get consumed
+                for (; i + 16 <= size; i += 12, dst += 16) {
+                    __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), simd::ascii(simd::unpack(in)));
+                }
+                return i + encodeScalar(src + i, size - i, dst);
+            }
+
+            GDSHARE_TARGET("ssse3")
+            inline size_t decodeSSSE3(const uint8_t* src, size_t size, uint8_t* dst, size_t cap, size_t & consumed) {
+                size_t i = 0, o = 0;
+                for (; i + 16 <= size && o + 16 <= cap; i += 16, o += 12) {
+                    __m128i bad;
+                    __m128i v = simd::lookup(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), bad);
+                    if (_mm_movemask_epi8(bad)) break;
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + o), simd::pack(v));
+                }
+                size_t rest;
+                o += decodeScalar(src + i, size - i, dst + o, cap - o, rest);
+                consumed = i + rest;
+                return o;
+            }
+
+            GDSHARE_TARGET("avx2")
+            inline size_t encodeAVX2(const uint8_t* src, size_t size, char* dst) {
+                size_t i = 0;
+                for (; i + 28 <= size; i += 24, dst += 32) {
+                    __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+                    __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 12));
+                    __m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+
+                    in = _mm256_shuffle_epi8(in, _mm256_setr_epi8(
+                        1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                        1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+                    __m256i t0 = _mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040));
+                    __m256i t1 = _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010));
+                    __m256i idx = _mm256_or_si256(t0, t1);
+
+                    __m256i cls = _mm256_subs_epu8(idx, _mm256_set1_epi8(51));
+                    cls = _mm256_or_si256(cls, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), idx), _mm256_set1_epi8(13)));
+                    const __m256i shift = _mm256_setr_epi8(
+                        71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -17, 32, 65, 0, 0,
+                        71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -17, 32, 65, 0, 0);
+                    __m256i out = _mm256_add_epi8(_mm256_shuffle_epi8(shift, cls), idx);
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), out);
+                }
+                return i + encodeSSSE3(src + i, size - i, dst);
+            }
+
+            GDSHARE_TARGET("avx2")
+            inline size_t decodeAVX2(const uint8_t* src, size_t size, uint8_t* dst, size_t cap, size_t & consumed) {
+                size_t i = 0, o = 0;
+                for (; i + 32 <= size && o + 32 <= cap; i += 32, o += 24) {
+                    __m256i bad;
+                    __m256i v = simd::lookup(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i)), bad);
+                    if (_mm256_movemask_epi8(bad)) break;
+
+                    v = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+                    v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00011000));
+                    v = _mm256_shuffle_epi8(v, _mm256_setr_epi8(
+                        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+                    v = _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + o), v);
+                }
+                size_t rest;
+                o += decodeSSSE3(src + i, size - i, dst + o, cap - o, rest);
+                consumed = i + rest;
+                return o;
+            }
+            #endif
+
+            /**
+             * Get the encode kernel for an instruction set. Kernels encode
+             * whole 3-byte groups and return the amount of bytes consumed.
+            */
+            inline size_t (*encoder(Isa isa))(const uint8_t*, size_t, char*) {
+                #if defined(GDSHARE_X86)
+                if (isa >= Isa::AVX2) return encodeAVX2;
+                if (isa >= Isa::SSSE3) return encodeSSSE3;
+                #endif
+                return encodeScalar;
+            }
+
+            /**
+             * Get the decode kernel for an instruction set. Kernels decode
+             * whole quads up to the first non-alphabet character.
+            */
+            inline size_t (*decoder(Isa isa))(const uint8_t*, size_t, uint8_t*, size_t, size_t &) {
+                #if defined(GDSHARE_X86)
+                if (isa >= Isa::AVX2) return decodeAVX2;
+                if (isa >= Isa::SSSE3) return decodeSSSE3;
+                #endif
+                return decodeScalar;
+            }
+        }
+
+        /**
+         * Incremental Base64 decoder. Whitespace, padding and other
+         * characters outside the alphabet are skipped, and runs of valid
+         * characters go through the vectorized kernels.
+        */
+        struct Base64Decoder {
+            /**
+             * Decode the next slice of input. Decoding stops early if the
+             * output buffer runs out of room. src and dst may be the same
+             * buffer for in-place decoding.
+             * @param src Input
+             * @param size Size of the input in bytes
+             * @param dst Output buffer
+             * @param cap Size of the output buffer
+             * @param consumed Receives the amount of input bytes consumed
+             * @returns Amount of bytes written
+            */
+            size_t decode(const uint8_t* src, size_t size, uint8_t* dst, size_t cap, size_t & consumed) {
+                static const auto kernel = base64x::decoder(bestIsa());
+                const auto & lut = detail::Base64Lookup.v;
+
+                size_t i = 0, o = 0;
+                while (i < size) {
+                    if (!$quadLen && o + 3 <= cap) {
+                        size_t used;
+                        o += kernel(src + i, size - i, dst + o, cap - o, used);
+                        i += used;
+                        if (i >= size) break;
+                    }
+
+                    int8_t v = lut[src[i]];
+                    // only a complete quad needs room; a partial one is
+                    // kept for the next call or for finish
+                    if (v >= 0 && $quadLen == 3 && o + 3 > cap) break;
+                    i++;
+                    if (v < 0) continue;
+
+                    $quad = ($quad << 6) | static_cast<uint32_t>(v);
+                    if (++$quadLen == 4) {
+                        dst[o++] = static_cast<uint8_t>($quad >> 16);
+                        dst[o++] = static_cast<uint8_t>($quad >> 8);
+                        dst[o++] = static_cast<uint8_t>($quad);
+                        $quad = 0;
+                        $quadLen = 0;
+                    }
+                }
+
+                consumed = i;
+                return o;
+            }
+
+            /**
+             * Flush a trailing partial quad.
+             * @param dst Output buffer with room for at least 2 bytes
+             * @returns Amount of bytes written
+            */
+            size_t finish(uint8_t* dst) {
+                size_t o = 0;
+                if ($quadLen == 2)
+                    dst[o++] = static_cast<uint8_t>($quad >> 4);
+                else if ($quadLen == 3) {
+                    dst[o++] = static_cast<uint8_t>($quad >> 10);
+                    dst[o++] = static_cast<uint8_t>($quad >> 2);
+                }
+                $quad = 0;
+                $quadLen = 0;
+                return o;
+            }
+
+            private:
+                uint32_t $quad = 0;
+                int $quadLen = 0;
+        };
+
+        /**
+         * Base64 encode into a caller-sized buffer with the URL-safe alphabet.
+         * @param src The data to encode
+         * @param size Size of the data in bytes
+         * @param dst Output buffer of at least base64x::encodedSize(size, pad) bytes
+         * @param pad Whether to pad the output with '='
+         * @returns Amount of characters written
+        */
+        inline size_t base64Encode(const uint8_t* src, size_t size, char* dst, bool pad = true) {
+            static const auto kernel = base64x::encoder(bestIsa());
+
+            size_t i = kernel(src, size, dst);
+            char* out = dst + i / 3 * 4;
+
+            if (size - i == 1) {
+                *out++ = base64x::Alphabet[src[i] >> 2];
+                *out++ = base64x::Alphabet[(src[i] & 3) << 4];
+                if (pad) { *out++ = '='; *out++ = '='; }
+            } else if (size - i == 2) {
+                *out++ = base64x::Alphabet[src[i] >> 2];
+                *out++ = base64x::Alphabet[((src[i] & 3) << 4) | (src[i + 1] >> 4)];
+                *out++ = base64x::Alphabet[(src[i + 1] & 15) << 2];
+                if (pad) *out++ = '=';
+            }
+
+            return out - dst;
+        }
+
+        /**
+         * Base64 decode into a caller-sized buffer. Accepts both the
+         * URL-safe and the standard alphabet.
+         * @param src The data to decode
+         * @param size Size of the data in bytes
+         * @param dst Output buffer of at least base64x::decodedSize(size)
+         * bytes. May be the same as src.
+         * @returns Amount of bytes written
+        */
+        inline size_t base64Decode(const uint8_t* src, size_t size, uint8_t* dst) {
+            Base64Decoder dec;
+            size_t used;
+            size_t o = dec.decode(src, size, dst, base64x::decodedSize(size), used);
+            return o + dec.finish(dst + o);
+        }
+
+        /**
+         * Base64 decode a buffer in place.
+         * @param data The buffer
+         * @param size Size of the buffer in bytes
+         * @returns Size of the decoded data at the start of the buffer
+        */
+        inline size_t base64DecodeInPlace(uint8_t* data, size_t size) {
+            // decoding never writes past the read position, and the
+            // trailing partial quad fits in the last 2-3 bytes read
+            Base64Decoder dec;
+            size_t used;
+            size_t o = dec.decode(data, size, data, size, used);
+            return o + dec.finish(data + o);
+        }
+
+        /**
+         * Vectorized drop-in for encoder::Base64.
+         * @param data The data to encode
+        */
+        inline std::vector<uint8_t> Base64(const std::vector<uint8_t> & data) {
+            std::vector<uint8_t> res (base64x::encodedSize(data.size()));
+            res.resize(base64Encode(data.data(), data.size(), reinterpret_cast<char*>(res.data())));
+            return res;
+        }
+
+        /**
+         * Vectorized drop-in for decoder::Base64X.
+         * @param data The data to decode
+        */
+        inline std::vector<uint8_t> Base64X(const std::vector<uint8_t> & data) {
+            std::vector<uint8_t> res (base64x::decodedSize(data.size()));
+            res.resize(base64Decode(data.data(), data.size(), res.data()));
+            return res;
+        }
+
+        /**
+         * Single-pass XOR -> Base64 -> inflate decoder. Input is fed in
+         * arbitrary slices and the inflated output is appended straight into
+         * the target string, so no full-size intermediate buffers exist.
+        */
+        struct StreamDecoder {
+            /**
+             * Create a decoder.
+             * @param out The string to append decoded data to
+             * @param key XOR key, or 0 to skip the XOR stage
+            */
+            StreamDecoder(std::string & out, int key = SaveKey)
+                : $out(out), $key(static_cast<uint8_t>(key)), $used(out.size()) {
+                std::memset(&$zs, 0, sizeof $zs);
+                // 15 + 32 = auto-detect zlib / gzip header
+                $zok = inflateInit2(&$zs, 15 + 32) == Z_OK;
+                $b64.resize(ChunkSize);
+                $xored.resize(ChunkSize);
+            }
+
+            StreamDecoder(const StreamDecoder &) = delete;
+            StreamDecoder & operator= (const StreamDecoder &) = delete;
+
+            ~StreamDecoder() {
+                if ($zok) inflateEnd(&$zs);
+            }
+
+            /**
+             * Decode the next slice of input.
+             * @param data The slice
+             * @param size Size of the slice in bytes
+             * @returns gdshare::Result
+            */
+            Result feed(const uint8_t* data, size_t size) {
+                if (!$zok)
+                    return { false, "Unable to initialize zlib" };
+
+                while (size) {
+                    size_t len = std::min(size, ChunkSize);
+                    xorInto($xored.data(), data, len, $key);
+                    data += len;
+                    size -= len;
+
+                    for (size_t i = 0; i < len;) {
+                        size_t used;
+                        $b64Len += $base64.decode(&$xored[i], len - i, &$b64[$b64Len], ChunkSize - $b64Len, used);
+                        i += used;
+
+                        // keep enough room for full-width vector stores
+                        if (ChunkSize - $b64Len < 64) {
+                            auto res = inflateBuffered();
+                            if (!res.OK) return res;
+                        }
+                    }
+                }
+
+                return { true, "" };
+            }
+
+            /**
+             * Flush any pending input and trim the output string to
+             * the decoded size.
+             * @returns gdshare::Result, failing if the compressed stream
+             * ended early
+            */
+            Result finish() {
+                if (!$zok)
+                    return { false, "Unable to initialize zlib" };
+
+                $b64Len += $base64.finish(&$b64[$b64Len]);
+
+                auto res = inflateBuffered();
+                $out.resize($used);
+                if (res.OK && !$ended)
+                    return { false, "Save file is truncated" };
+                return res;
+            }
+
+            private:
+                Result inflateBuffered() {
+                    $zs.next_in = $b64.data();
+                    $zs.avail_in = static_cast<uInt>($b64Len);
+
+                    while (!$ended) {
+                        if ($out.size() - $used < ChunkSize)
+                            $out.resize($used + ChunkSize * 4);
+
+                        $zs.next_out = reinterpret_cast<Bytef*>(&$out[$used]);
+                        $zs.avail_out = static_cast<uInt>($out.size() - $used);
+
+                        int ret = inflate(&$zs, Z_NO_FLUSH);
+                        $used = $out.size() - $zs.avail_out;
+
+                        if (ret == Z_STREAM_END)
+                            $ended = true;
+                        else if (ret == Z_BUF_ERROR)
+                            break;
+                        else if (ret != Z_OK)
+                            return { false, std::string("Inflate error: ") + ($zs.msg ? $zs.msg : "unknown") };
+
+                        // output space left over means all input was consumed
+                        if ($zs.avail_out)
+                            break;
+                    }
+
+                    $b64Len = 0;
+                    return { true, "" };
+                }
+
+                std::string& $out;
+                uint8_t $key;
+                size_t $used;
+                z_stream $zs;
+                bool $zok = false;
+                bool $ended = false;
+                std::vector<uint8_t> $xored;
+                std::vector<uint8_t> $b64;
+                size_t $b64Len = 0;
+                Base64Decoder $base64;
+        };
+
+        /**
+         * Decode a whole CC file in one pass.
+         * @param data The raw file contents
+         * @param size Size of the contents in bytes
+         * @param out String that receives the decoded XML. rapidxml can
+         * parse it in place.
+         * @param callback Optional progress callback, same as CCFile::init
+         * @returns gdshare::Result
+        */
+        inline Result decodeX(
+            const uint8_t* data, size_t size, std::string & out,
+            std::function<void (std::string, int)> callback = nullptr
+        ) {
+            out.clear();
+
+            // already decoded saves are plain XML
+            if (size && data[0] == '<') {
+                out.assign(reinterpret_cast<const char*>(data), size);
+                if (callback) callback("Decoded", 100);
+                return { true, "" };
+            }
+
+            // compressed XML usually expands 3-8x after Base64
+            out.reserve(size * 4);
+
+            StreamDecoder dec (out);
+            int lastPercent = -1;
+            for (size_t pos = 0; pos < size; pos += ChunkSize) {
+                auto res = dec.feed(data + pos, std::min(ChunkSize, size - pos));
+                if (!res.OK) return res;
+
+                if (callback) {
+                    int percent = static_cast<int>((pos * 100) / size);
+                    if (percent != lastPercent)
+                        callback("Decoding", (lastPercent = percent));
+                }
+            }
+
+            auto res = dec.finish();
+            if (res.OK && out.empty())
+                return { false, "File decoded to nothing" };
+            if (res.OK && callback)
+                callback("Decoded", 100);
+            return res;
+        }
+
+        /**
+         * Options for codec::GZip.
+        */
+        struct GZipOptions {
+            /**
+             * zlib compression level, 0-9.
+            */
+            int level = Z_DEFAULT_COMPRESSION;
+            /**
+             * Amount of worker threads, 0 for one per hardware thread.
+            */
+            unsigned int threads = 0;
+            /**
+             * Size of the independently deflated input blocks.
+            */
+            size_t blockSize = 0x20000;
+        };
+
+        namespace detail {
+            // deflate window; each block is primed with this much of the previous one
+            static constexpr size_t DictSize = 0x8000;
+
+            struct DeflatedBlock {
+                std::vector<uint8_t> data;
+                uLong crc;
+                bool ok;
+            };
+
+            inline DeflatedBlock deflateBlock(
+                const uint8_t* dict, size_t dictSize,
+                const uint8_t* data, size_t size,
+                int level, bool last
+            ) {
+                DeflatedBlock res { {}, backend::current().crc32(0, data, size), false };
+
+                z_stream zs;
+                std::memset(&zs, 0, sizeof zs);
+                // raw deflate, the gzip framing is written once for all blocks
+                if (deflateInit2(&zs, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+                    return res;
+
+                if (dictSize)
+                    deflateSetDictionary(&zs, dict, static_cast<uInt>(dictSize));
+
+                // room for the sync flush marker on top of the bound
+                res.data.resize(deflateBound(&zs, static_cast<uLong>(size)) + 16);
+                zs.next_in = const_cast<Bytef*>(data);
+                zs.avail_in = static_cast<uInt>(size);
+                zs.next_out = res.data.data();
+                zs.avail_out = static_cast<uInt>(res.data.size());
+
+                // sync flush ends the block on a byte boundary so blocks can be concatenated
+                int ret = deflate(&zs, last ? Z_FINISH : Z_SYNC_FLUSH);
+                res.ok = last ? ret == Z_STREAM_END : ret == Z_OK;
+                res.data.resize(res.data.size() - zs.avail_out);
+
+                deflateEnd(&zs);
+                return res;
+            }
+        }
+
+        /**
+         * Compress data into a single gzip member, deflating blocks in
+         * parallel. Every block is primed with the 32 KB before it, so
+         * the ratio stays close to a single-stream deflate. Inputs that fit
+         * one block, or single-threaded runs, go through the selected
+         * backend in one shot instead.
+         * @param data The data to compress
+         * @param size Size of the data in bytes
+         * @param options Compression level, thread count and block size
+         * @returns The gzip data, or an empty vector on failure
+        */
+        inline std::vector<uint8_t> GZip(const uint8_t* data, size_t size, GZipOptions options = {}) {
+            size_t blockSize = std::max(options.blockSize, detail::DictSize);
+            size_t count = size ? (size + blockSize - 1) / blockSize : 1;
+
+            unsigned int threads = options.threads ? options.threads : ThreadPool::defaultSize();
+            if (count == 1 || threads == 1)
+                return backend::current().gzip(data, size, options.level);
+
+            std::vector<detail::DeflatedBlock> blocks (count);
+            auto deflateAt = [&](size_t ix) -> detail::DeflatedBlock {
+                size_t start = ix * blockSize;
+                size_t len = std::min(blockSize, size - start);
+                size_t dict = std::min(start, detail::DictSize);
+                return detail::deflateBlock(
+                    data + start - dict, dict,
+                    data + start, len,
+                    options.level, ix == count - 1
+                );
+            };
+
+            {
+                ThreadPool pool (std::min<size_t>(threads, count));
+                std::vector<std::future<detail::DeflatedBlock>> jobs;
+                for (size_t ix = 0; ix < count; ix++)
+                    jobs.push_back(pool.run([&deflateAt, ix]() { return deflateAt(ix); }));
+                for (size_t ix = 0; ix < count; ix++)
+                    blocks[ix] = jobs[ix].get();
+            }
+
+            size_t total = 18;
+            uLong crc = crc32(0L, Z_NULL, 0);
+            for (size_t ix = 0; ix < count; ix++) {
+                if (!blocks[ix].ok)
+                    return {};
+                total += blocks[ix].data.size();
+                size_t len = std::min(blockSize, size - ix * blockSize);
+                crc = crc32_combine(crc, blocks[ix].crc, static_cast<z_off_t>(len));
+            }
+
+            // same header GD writes: no name, no mtime, OS = NTFS
+            std::vector<uint8_t> res = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0x0b };
+            res.reserve(total);
+            for (auto & block : blocks)
+                res.insert(res.end(), block.data.begin(), block.data.end());
+
+            uint32_t isize = static_cast<uint32_t>(size);
+            for (int i = 0; i < 4; i++) res.push_back(static_cast<uint8_t>(crc >> (i * 8)));
+            for (int i = 0; i < 4; i++) res.push_back(static_cast<uint8_t>(isize >> (i * 8)));
+
+            return res;
+        }
+
+        /**
+         * Parallel drop-in for encoder::GZip.
+         * @param data The data to compress
+         * @param options Compression level, thread count and block size
+        */
+        inline std::vector<uint8_t> GZip(const std::vector<uint8_t> & data, GZipOptions options = {}) {
+            return GZip(data.data(), data.size(), options);
+        }
+
+        /**
+         * Receives output of the streaming encoders in pieces. Returns
+         * false to abort.
+        */
+        using Sink = std::function<bool (const uint8_t*, size_t)>;
+
+        /**
+         * Streaming version of GZip: input is written in pieces and the
+         * compressed output is passed on as blocks finish, so neither the
+         * input nor the output ever has to be in memory as a whole. With
+         * multiple threads, a bounded number of blocks are deflated at once.
+        */
+        struct GZipStream {
+            /**
+             * Create a stream.
+             * @param sink Receives the gzip data in order
+             * @param options Compression level, thread count and block size
+            */
+            GZipStream(Sink sink, GZipOptions options = {})
+              : $sink(std::move(sink)), $options(options) {
+                $options.blockSize = std::max($options.blockSize, detail::DictSize);
+                unsigned int threads = $options.threads ? $options.threads : ThreadPool::defaultSize();
+                if (threads > 1)
+                    $pool = std::make_unique<ThreadPool>(threads);
+                $block.reserve($options.blockSize);
+            }
+
+            GZipStream(const GZipStream &) = delete;
+            GZipStream & operator= (const GZipStream &) = delete;
+
+            ~GZipStream() {
+                // let in-flight blocks finish before their inputs go away
+                for (auto & job : $pending)
+                    job.result.wait();
+            }
+
+            /**
+             * Compress the next piece of input.
+             * @returns false if compression or the sink failed
+            */
+            bool write(const uint8_t* data, size_t size) {
+                while (size && $ok) {
+                    size_t len = std::min(size, $options.blockSize - $block.size());
+                    $block.insert($block.end(), data, data + len);
+                    data += len;
+                    size -= len;
+                    if ($block.size() == $options.blockSize)
+                        this->submit(false);
+                }
+                return $ok;
+            }
+
+            /**
+             * Compress what's left and write the gzip trailer.
+             * @returns false if compression or the sink failed at any point
+            */
+            bool finish() {
+                if ($finished) return $ok;
+                $finished = true;
+
+                this->submit(true);
+                while (!$pending.empty() && $ok)
+                    this->drain();
+                if (!$ok) return false;
+
+                uint8_t trailer[8];
+                uint32_t isize = static_cast<uint32_t>($total);
+                for (int i = 0; i < 4; i++) trailer[i] = static_cast<uint8_t>($crc >> (i * 8));
+                for (int i = 0; i < 4; i++) trailer[4 + i] = static_cast<uint8_t>(isize >> (i * 8));
+                return $ok = $sink(trailer, sizeof trailer);
+            }
+
+            protected:
+                struct Job {
+                    std::future<detail::DeflatedBlock> result;
+                    size_t size;
+                };
+
+                void submit(bool last) {
+                    if (!$ok) return;
+
+                    // each job owns its dictionary + block, laid out back to back
+                    auto input = std::make_shared<std::vector<uint8_t>>();
+                    input->reserve($dict.size() + $block.size());
+                    input->insert(input->end(), $dict.begin(), $dict.end());
+                    input->insert(input->end(), $block.begin(), $block.end());
+                    size_t dict = $dict.size(), size = $block.size();
+                    int level = $options.level;
+
+                    auto run = [input, dict, size, level, last]() -> detail::DeflatedBlock {
+                        return detail::deflateBlock(input->data(), dict, input->data() + dict, size, level, last);
+                    };
+
+                    size_t keep = std::min($block.size(), detail::DictSize);
+                    $dict.assign($block.end() - keep, $block.end());
+                    $block.clear();
+
+                    if ($pool) {
+                        $pending.push_back({ $pool->run(std::move(run)), size });
+                        while ($pending.size() > 2 * static_cast<size_t>($pool->size()))
+                            this->drain();
+                    } else
+                        this->emit(run(), size);
+                }
+
+                void drain() {
+                    Job job = std::move($pending.front());
+                    $pending.pop_front();
+                    this->emit(job.result.get(), job.size);
+                }
+
+                void emit(detail::DeflatedBlock block, size_t size) {
+                    if (!$ok) return;
+                    if (!block.ok) {
+                        $ok = false;
+                        return;
+                    }
+
+                    if (!$started) {
+                        // same header GD writes: no name, no mtime, OS = NTFS
+                        static const uint8_t header[] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0x0b };
+                        $started = true;
+                        if (!($ok = $sink(header, sizeof header)))
+                            return;
+                    }
+
+                    $crc = crc32_combine($crc, block.crc, static_cast<z_off_t>(size));
+                    $total += size;
+                    $ok = $sink(block.data.data(), block.data.size());
+                }
+
+                Sink $sink;
+                GZipOptions $options;
+                std::unique_ptr<ThreadPool> $pool;
+                std::deque<Job> $pending;
+                std::vector<uint8_t> $block;
+                std::vector<uint8_t> $dict;
+                uLong $crc = crc32(0L, Z_NULL, 0);
+                uint64_t $total = 0;
+                bool $started = false;
+                bool $finished = false;
+                bool $ok = true;
+        };
+
+        /**
+         * Streaming Base64 encoder with an optional XOR stage, i.e. the
+         * last two steps of encoding a save.
+        */
+        struct EncodeStream {
+            /**
+             * Create a stream.
+             * @param sink Receives the encoded text
+             * @param key XOR key, or 0 to skip the XOR stage
+            */
+            EncodeStream(Sink sink, int key = SaveKey)
+              : $sink(std::move(sink)), $key(key) {
+                $out.resize(base64x::encodedSize(ChunkSize));
+            }
+
+            /**
+             * Encode the next piece of input.
+             * @returns false if the sink failed
+            */
+            bool write(const uint8_t* data, size_t size) {
+                // top up a partial triple left from the last call
+                while ($carrySize && $carrySize < 3 && size) {
+                    $carry[$carrySize++] = *data++;
+                    size--;
+                }
+                if ($carrySize == 3) {
+                    if (!this->encode($carry, 3, false)) return false;
+                    $carrySize = 0;
+                }
+
+                while (size >= 3 && $ok) {
+                    size_t len = std::min(size - size % 3, ChunkSize - ChunkSize % 3);
+                    if (!this->encode(data, len, false)) return false;
+                    data += len;
+                    size -= len;
+                }
+
+                std::memcpy($carry + $carrySize, data, size);
+                $carrySize += size;
+                return $ok;
+            }
+
+            /**
+             * Encode the last partial triple with padding.
+             * @returns false if the sink failed at any point
+            */
+            bool finish() {
+                if ($carrySize)
+                    this->encode($carry, $carrySize, true);
+                $carrySize = 0;
+                return $ok;
+            }
+
+            protected:
+                bool encode(const uint8_t* data, size_t size, bool pad) {
+                    if (!$ok) return false;
+                    size_t len = base64Encode(data, size, reinterpret_cast<char*>($out.data()), pad);
+                    if ($key)
+                        xorInPlace($out.data(), len, $key);
+                    return $ok = $sink($out.data(), len);
+                }
+
+                Sink $sink;
+                int $key;
+                std::vector<uint8_t> $out;
+                uint8_t $carry[3];
+                size_t $carrySize = 0;
+                bool $ok = true;
+        };
+
+        /**
+         * Inflate gzip or zlib data, appending to a string.
+         * @param data The compressed data
+         * @param size Size of the data in bytes
+         * @param out The string to append to
+         * @returns false if the data is not a complete stream
+        */
+        inline bool inflateInto(const uint8_t* data, size_t size, std::string & out) {
+            return backend::current().inflate(data, size, out);
+        }
+
+        /**
+         * Count the objects in a level's k4 without materializing its data.
+         * The value is Base64 decoded and inflated ChunkSize bytes at a
+         * time and the ';' separators are counted as the data streams past,
+         * so memory use doesn't grow with the level.
+         * @param k4 The level's encoded data
+         * @param size Size of the data in bytes
+         * @returns The object count, same as Level::objectCount; 0 if the
+         * data is empty or can't be decoded
+        */
+        inline int countObjects(const char* k4, size_t size) {
+            if (!size) return 0;
+
+            z_stream zs;
+            std::memset(&zs, 0, sizeof zs);
+            if (inflateInit2(&zs, 15 + 32) != Z_OK)
+                return 0;
+
+            std::vector<uint8_t> gz (ChunkSize), out (ChunkSize);
+            Base64Decoder b64;
+            const uint8_t* src = reinterpret_cast<const uint8_t*>(k4);
+            size_t read = 0, total = 0, separators = 0;
+            bool flushed = false;
+            int ret = Z_OK;
+
+            while (ret == Z_OK) {
+                if (!zs.avail_in) {
+                    size_t len = 0;
+                    if (read < size) {
+                        size_t used;
+                        len = b64.decode(src + read, size - read, gz.data(), gz.size(), used);
+                        read += used;
+                    } else if (!flushed) {
+                        len = b64.finish(gz.data());
+                        flushed = true;
+                    } else break;
+                    zs.next_in = gz.data();
+                    zs.avail_in = static_cast<uInt>(len);
+                }
+
+                zs.next_out = out.data();
+                zs.avail_out = static_cast<uInt>(out.size());
+                ret = inflate(&zs, Z_NO_FLUSH);
+                if (ret == Z_BUF_ERROR) ret = Z_OK;
+
+                size_t produced = out.size() - zs.avail_out;
+                total += produced;
+                separators += countByte(out.data(), produced, ';');
+            }
+            inflateEnd(&zs);
+
+            if (ret != Z_STREAM_END || !total)
+                return 0;
+            return static_cast<int>(separators) - 1;
+        }
+
+        /**
+         * Drop-in for decoder::GZipX.
+         * @param data gzip or zlib data to decompress
+         * @returns The decompressed data, or an empty vector on failure
+        */
+        inline std::vector<uint8_t> GZipX(const std::vector<uint8_t> & data) {
+            std::string out;
+            if (!inflateInto(data.data(), data.size(), out))
+                return {};
+            return std::vector<uint8_t>(out.begin(), out.end());
+        }
+    }
+}
@@ -0,0 +1,261 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <cstdint>
+#include <cstdlib>
+#include "gdshare.hpp"
+#include "gdshare-codec.hpp"
+#include "gdshare-view.hpp"
+#include "gdshare-objects.hpp"
+
+namespace gdshare {
+    /**
+     * Decoded level data and object counts, kept per level so repeated
+     * queries don't Base64-decode and inflate k4 again. An entry is tied to
+     * the exact k4 value it was decoded from: once k4 is replaced, through
+     * Level::data, Level::key or view::set, the entry is thrown away on its
+     * next use.
+     *
+     * Decoded strings count against a memory budget; when it's exceeded
+     * the least recently used ones are released. Object counts are tiny
+     * and are kept until the entry is invalidated.
+    */
+    struct LevelDataCache {
+        /**
+         * Default budget for decoded data: GDSHARE_DATA_CACHE_MB megabytes
+         * if set, else 256 MB.
+        */
+        static size_t defaultBudget() {
+            const char* env = std::getenv("GDSHARE_DATA_CACHE_MB");
+            if (env && *env)
+                return static_cast<size_t>(std::strtoull(env, nullptr, 10)) << 20;
+            return size_t(256) << 20;
+        }
+
+        /**
+         * Create a cache.
+         * @param budget Maximum amount of decoded bytes to keep, 0 to keep
+         * only counts
+        */
+        LevelDataCache(size_t budget = defaultBudget())
+            : $budget(budget) {}
+
+        /**
+         * Get the decoded data of a level.
+         * @param level The level
+         * @returns The level's data, or "" if it has none or can't be
+         * decoded. Valid until the next call on the cache.
+        */
+        const std::string & data(const Level* level) {
+            Entry & entry = this->entry(level);
+            entry.used = ++$tick;
+
+            if (!entry.hasData) {
+                // a failed decode is neither kept nor charged, so the next
+                // call tries again
+                std::string decoded;
+                if (!decode(view::get<Key::Data>(level), decoded)) {
+                    static const std::string none;
+                    return none;
+                }
+                entry.data = std::move(decoded);
+                entry.data.shrink_to_fit();
+                entry.hasData = true;
+                $bytes += entry.data.size();
+
+                if (entry.objects < 0)
+                    entry.objects = count(entry.data);
+
+                this->trim(&entry);
+            }
+            return entry.data;
+        }
+
+        /**
+         * Set the data of a level. Encodes it like Level::data and keeps
+         * the raw string as the cached decoded data; pass an rvalue to hand
+         * it over without a copy.
+         * @param level The level
+         * @param raw The raw level string
+         * @returns The level
+        */
+        Level* data(Level* level, std::string raw) {
+            view::set<Key::Data>(level, encode(raw));
+
+            Entry & entry = this->entry(level);
+            $bytes += raw.size();
+            entry.data = std::move(raw);
+            entry.hasData = true;
+            entry.objects = count(entry.data);
+            entry.used = ++$tick;
+            this->trim(&entry);
+            return level;
+        }
+
+        /**
+         * Get the object count of a level. Counted from the cached data if
+         * there is any, otherwise streamed from k4 in constant memory; the
+         * result is kept either way.
+         * @param level The level
+        */
+        int objectCount(const Level* level) {
+            Entry & entry = this->entry(level);
+            if (entry.objects < 0) {
+                if (entry.hasData)
+                    entry.objects = count(entry.data);
+                else {
+                    auto k4 = view::get<Key::Data>(level);
+                    entry.objects = codec::countObjects(k4.data(), k4.size());
+                }
+            }
+            return entry.objects;
+        }
+
+        /**
+         * Parse a level's objects. Uses the cached data if there is any.
+         * @param level The level
+         * @returns The level's objects, see ObjectTable
+        */
+        ObjectTable objects(const Level* level) {
+            return ObjectTable::parse(this->data(level));
+        }
+
+        /**
+         * Write edited objects back into a level.
+         * @param level The level
+         * @param objects The level's objects, from LevelDataCache::objects
+         * @returns The level
+        */
+        Level* objects(Level* level, const ObjectTable & objects) {
+            return this->data(level, objects.serialize());
+        }
+
+        /**
+         * Forget everything about a level. Needed before a Level is
+         * deleted, since another one could later be allocated at the same
+         * address.
+        */
+        void invalidate(const Level* level) {
+            auto it = $entries.find(level);
+            if (it == $entries.end()) return;
+            $bytes -= it->second.data.size();
+            $entries.erase(it);
+        }
+
+        /**
+         * Forget everything.
+        */
+        void clear() {
+            $entries.clear();
+            $bytes = 0;
+        }
+
+        /**
+         * Release all decoded data but keep the object counts. Call under
+         * memory pressure.
+        */
+        void drop() {
+            for (auto & [lvl, entry] : $entries)
+                release(entry);
+        }
+
+        /**
+         * Change the memory budget, releasing data if it's now exceeded.
+         * @param bytes Maximum amount of decoded bytes to keep
+        */
+        void budget(size_t bytes) {
+            $budget = bytes;
+            this->trim(nullptr);
+        }
+
+        /**
+         * Get the memory budget in bytes.
+        */
+        size_t budget() const {
+            return $budget;
+        }
+
+        /**
+         * Get the amount of decoded bytes currently held.
+        */
+        size_t memoryUsage() const {
+            return $bytes;
+        }
+
+        protected:
+            struct Entry {
+                const char* source = nullptr;
+                size_t sourceSize = 0;
+                std::string data;
+                bool hasData = false;
+                int objects = -1;
+                uint64_t used = 0;
+            };
+
+            /**
+             * Get the entry of a level, resetting it if k4 has changed.
+            */
+            Entry & entry(const Level* level) {
+                auto k4 = view::get<Key::Data>(level);
+                Entry & entry = $entries[level];
+                if (entry.source != k4.data() || entry.sourceSize != k4.size()) {
+                    release(entry);
+                    entry.objects = -1;
+                    entry.source = k4.data();
+                    entry.sourceSize = k4.size();
+                }
+                return entry;
+            }
+
+            void release(Entry & entry) {
+                $bytes -= entry.data.size();
+                std::string().swap(entry.data);
+                entry.hasData = false;
+            }
+
+            /**
+             * Release least recently used data until within budget.
+             * @param keep Entry that must stay, e.g. the one just returned
+            */
+            void trim(const Entry* keep) {
+                while ($bytes > $budget) {
+                    Entry* oldest = nullptr;
+                    for (auto & [lvl, entry] : $entries)
+                        if (&entry != keep && entry.hasData && !entry.data.empty() &&
+                            (!oldest || entry.used < oldest->used))
+                            oldest = &entry;
+                    if (!oldest) return;
+                    release(*oldest);
+                }
+            }
+
+            static bool decode(std::string_view k4, std::string & out) {
+                if (k4.empty()) return false;
+                std::string gz (codec::base64x::decodedSize(k4.size()), '\0');
+                gz.resize(codec::base64Decode(
+                    reinterpret_cast<const uint8_t*>(k4.data()), k4.size(),
+                    reinterpret_cast<uint8_t*>(&gz[0])
+                ));
+                return codec::inflateInto(reinterpret_cast<const uint8_t*>(gz.data()), gz.size(), out);
+            }
+
+            static std::string encode(std::string_view data) {
+                auto gz = codec::GZip(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+                std::string res (codec::base64x::encodedSize(gz.size()), '\0');
+                res.resize(codec::base64Encode(gz.data(), gz.size(), &res[0]));
+                return res;
+            }
+
+            static int count(const std::string & data) {
+                if (data.empty()) return 0;
+                return static_cast<int>(codec::countByte(reinterpret_cast<const uint8_t*>(data.data()), data.size(), ';')) - 1;
+            }
+
+            std::unordered_map<const Level*, Entry> $entries;
+            size_t $budget;
+            size_t $bytes = 0;
+            uint64_t $tick = 0;
+    };
+}
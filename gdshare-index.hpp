@@ -0,0 +1,242 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include "gdshare.hpp"
+#include "gdshare-io.hpp"
+#include "gdshare-view.hpp"
+
+namespace gdshare {
+    /**
+     * Compact metadata table for the levels in a save: one fixed-width
+     * record per level plus a single string heap. Enough to answer list,
+     * find and info without touching the XML or decoding any level data.
+    */
+    struct LevelIndex {
+        static constexpr uint32_t Magic = 0x58444947; // "GIDX"
+        static constexpr uint32_t Version = 1;
+
+        /**
+         * A string stored in the heap.
+        */
+        struct StrRef {
+            uint32_t offset;
+            uint32_t size;
+        };
+
+        /**
+         * Metadata of one level. Order matches CCLocalLevelsX::getLevels.
+        */
+        struct Record {
+            StrRef name;
+            StrRef creator;
+            StrRef description;
+            StrRef song;
+            StrRef length;
+            int32_t version;
+            int32_t attempts;
+            int32_t objects;
+            int32_t editorTime;
+        };
+
+        /**
+         * Build an index from a list of levels. Object counts need every
+         * level's data decoded, so they start out unknown (-1) and are
+         * filled in with setObjects as they get computed.
+         * @param levels The levels to index
+         * @returns The built index
+        */
+        static LevelIndex build(const std::vector<Level*> & levels) {
+            LevelIndex res;
+            res.$records.reserve(levels.size());
+            for (auto lvl : levels)
+                res.add(lvl);
+            return res;
+        }
+
+        /**
+         * Append a level's record. Only reads the level while adding, so
+         * the level may be thrown away afterwards.
+         * @param level The level, next in save order
+        */
+        void add(Level* level) {
+            $records.push_back({
+                this->intern(view::name(level)),
+                this->intern(view::creator(level)),
+                this->intern(level->description()),
+                this->intern(level->song()),
+                this->intern(view::length(level)),
+                view::get<Key::Version>(level),
+                view::get<Key::Attempts>(level),
+                -1,
+                view::get<Key::EditorTime>(level)
+            });
+        }
+
+        /**
+         * Get the amount of levels in the index.
+        */
+        size_t size() const {
+            return $records.size();
+        }
+
+        /**
+         * Get a level's record.
+         * @param ix The level's position in the save
+        */
+        const Record & at(size_t ix) const {
+            return $records.at(ix);
+        }
+
+        /**
+         * Store a level's object count.
+         * @param ix The level's position in the save
+         * @param objects The level's object count
+        */
+        void setObjects(size_t ix, int32_t objects) {
+            $records.at(ix).objects = objects;
+        }
+
+        /**
+         * Get a string from the heap.
+         * @param ref The string's reference in a Record
+         * @returns View into the heap, valid as long as the index
+        */
+        std::string_view str(StrRef ref) const {
+            return std::string_view($heap.data() + ref.offset, ref.size);
+        }
+
+        /**
+         * Get a level's name.
+         * @param ix The level's position in the save
+        */
+        std::string_view name(size_t ix) const {
+            return this->str($records.at(ix).name);
+        }
+
+        /**
+         * Find a level by its name.
+         * @param name The level's name
+         * @param casesensitive Whether to match the name case-sensitive
+         * @returns The level's position in the save, or -1 if not found
+        */
+        long long find(std::string_view name, bool casesensitive = false) const {
+            auto eq = [casesensitive](unsigned char a, unsigned char b) {
+                return casesensitive ? a == b : std::tolower(a) == std::tolower(b);
+            };
+
+            for (size_t ix = 0; ix < $records.size(); ix++) {
+                auto lvl = this->name(ix);
+                if (lvl.size() == name.size() && std::equal(lvl.begin(), lvl.end(), name.begin(), eq))
+                    return static_cast<long long>(ix);
+            }
+            return -1;
+        }
+
+        /**
+         * Get the positions of all levels sorted by name, case-insensitive.
+        */
+        std::vector<size_t> sortedByName() const {
+            std::vector<size_t> res ($records.size());
+            for (size_t ix = 0; ix < res.size(); ix++)
+                res[ix] = ix;
+
+            std::stable_sort(res.begin(), res.end(), [this](size_t a, size_t b) {
+                auto x = this->name(a), y = this->name(b);
+                return std::lexicographical_compare(x.begin(), x.end(), y.begin(), y.end(),
+                    [](unsigned char c, unsigned char d) { return std::tolower(c) < std::tolower(d); });
+            });
+            return res;
+        }
+
+        /**
+         * Write the index to a file.
+         * @param path The file to write
+         * @param id Identity of the save the index was built from
+         * @returns true if the file was written
+        */
+        bool save(const std::filesystem::path & path, const io::FileIdentity & id) const {
+            std::error_code err;
+            std::filesystem::create_directories(path.parent_path(), err);
+
+            auto tmp = path;
+            tmp += ".tmp";
+            {
+                std::ofstream out (tmp, std::ios::binary | std::ios::trunc);
+                if (!out.is_open()) return false;
+
+                uint32_t head[2] = { Magic, Version };
+                uint64_t sizes[2] = { $records.size(), $heap.size() };
+                out.write(reinterpret_cast<const char*>(head), sizeof head);
+                id.write(out);
+                out.write(reinterpret_cast<const char*>(sizes), sizeof sizes);
+                out.write(reinterpret_cast<const char*>($records.data()), $records.size() * sizeof(Record));
+                out.write($heap.data(), $heap.size());
+                if (!out) return false;
+            }
+
+            std::filesystem::rename(tmp, path, err);
+            return !err;
+        }
+
+        /**
+         * Read an index written with LevelIndex::save.
+         * @param path The file to read
+         * @param id Identity of the current save; the index is rejected if
+         * it was built from a different version of the file
+         * @param out Receives the index
+         * @returns true if a matching index was read
+        */
+        static bool load(const std::filesystem::path & path, const io::FileIdentity & id, LevelIndex & out) {
+            std::ifstream in (path, std::ios::binary);
+            if (!in.is_open()) return false;
+
+            uint32_t head[2] = { 0, 0 };
+            in.read(reinterpret_cast<char*>(head), sizeof head);
+            if (!in || head[0] != Magic || head[1] != Version)
+                return false;
+
+            io::FileIdentity built;
+            if (!built.read(in) || !(built == id))
+                return false;
+
+            uint64_t sizes[2] = { 0, 0 };
+            in.read(reinterpret_cast<char*>(sizes), sizeof sizes);
+            if (!in) return false;
+            // don't allocate for sizes the file can't hold
+            uint64_t left = io::remaining(in);
+            if (sizes[0] > left / sizeof(Record) || sizes[1] > left - sizes[0] * sizeof(Record))
+                return false;
+
+            LevelIndex res;
+            res.$records.resize(sizes[0]);
+            res.$heap.resize(sizes[1]);
+            in.read(reinterpret_cast<char*>(res.$records.data()), sizes[0] * sizeof(Record));
+            in.read(&res.$heap[0], sizes[1]);
+            if (!in) return false;
+
+            for (auto & rec : res.$records)
+                for (auto ref : { rec.name, rec.creator, rec.description, rec.song, rec.length })
+                    if (static_cast<uint64_t>(ref.offset) + ref.size > sizes[1])
+                        return false;
+
+            out = std::move(res);
+            return true;
+        }
+
+        private:
+            StrRef intern(std::string_view str) {
+                StrRef ref { static_cast<uint32_t>($heap.size()), static_cast<uint32_t>(str.size()) };
+                $heap += str;
+                return ref;
+            }
+
+            std::vector<Record> $records;
+            std::string $heap;
+    };
+}
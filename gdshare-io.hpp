@@ -0,0 +1,765 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <system_error>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <cerrno>
+#include "gdshare.hpp"
+
+#ifdef _WIN32
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <Windows.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+namespace gdshare {
+    namespace io {
+        /**
+         * Read-only memory mapping of a whole file. The decode pipeline
+         * reads straight from the mapping, so the file is never copied
+         * into a separate buffer.
+        */
+        struct MappedFile {
+            MappedFile() = default;
+
+            /**
+             * Map a file. Check isOpen() for success.
+             * @param path The file to map
+             * @param populate Whether to fault in the whole file up front.
+             * By default the kernel is only told the file is read
+             * sequentially, so read-ahead overlaps with decoding.
+            */
+            MappedFile(const std::string & path, bool populate = false) {
+                this->open(path, populate);
+            }
+
+            MappedFile(const MappedFile &) = delete;
+            MappedFile & operator= (const MappedFile &) = delete;
+
+            MappedFile(MappedFile && other) noexcept {
+                *this = std::move(other);
+            }
+
+            MappedFile & operator= (MappedFile && other) noexcept {
+                if (this != &other) {
+                    this->close();
+                    std::swap($data, other.$data);
+                    std::swap($size, other.$size);
+                    #ifdef _WIN32
+                    std::swap($file, other.$file);
+                    std::swap($mapping, other.$mapping);
+                    #else
+                    std::swap($fd, other.$fd);
+                    #endif
+                }
+                return *this;
+            }
+
+            ~MappedFile() {
+                this->close();
+            }
+
+            /**
+             * Map a file, unmapping whatever was mapped before.
+             * @param path The file to map
+             * @param populate See MappedFile::MappedFile
+             * @returns gdshare::Result
+            */
+            Result open(const std::string & path, bool populate = false) {
+                this->close();
+
+                #ifdef _WIN32
+                $file = CreateFileA(
+                    path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                    OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr
+                );
+                if ($file == INVALID_HANDLE_VALUE)
+                    return { false, "Unable to open file " + path };
+
+                LARGE_INTEGER size;
+                if (!GetFileSizeEx($file, &size)) {
+                    this->close();
+                    return { false, "Unable to get size of " + path };
+                }
+                $size = static_cast<size_t>(size.QuadPart);
+
+                // empty files can't be mapped, but are valid
+                if (!$size) return { true, "" };
+
+                $mapping = CreateFileMappingA($file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                if ($mapping)
+                    $data = static_cast<const uint8_t*>(MapViewOfFile($mapping, FILE_MAP_READ, 0, 0, 0));
+                if (!$data) {
+                    this->close();
+                    return { false, "Unable to map " + path };
+                }
+
+                #if defined(_WIN32_WINNT) && _WIN32_WINNT >= 0x0602
+                if (populate) {
+                    WIN32_MEMORY_RANGE_ENTRY range { const_cast<uint8_t*>($data), $size };
+                    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+                }
+                #endif
+                #else
+                $fd = ::open(path.c_str(), O_RDONLY);
+                if ($fd < 0)
+                    return { false, "Unable to open file " + path };
+
+                struct stat st;
+                if (fstat($fd, &st) != 0) {
+                    this->close();
+                    return { false, "Unable to get size of " + path };
+                }
+                $size = static_cast<size_t>(st.st_size);
+
+                if (!$size) return { true, "" };
+
+                int flags = MAP_PRIVATE;
+                #ifdef MAP_POPULATE
+                if (populate) flags |= MAP_POPULATE;
+                #endif
+
+                void* addr = mmap(nullptr, $size, PROT_READ, flags, $fd, 0);
+                if (addr == MAP_FAILED) {
+                    this->close();
+                    return { false, "Unable to map " + path };
+                }
+                $data = static_cast<const uint8_t*>(addr);
+
+                madvise(addr, $size, MADV_SEQUENTIAL);
+                if (!populate)
+                    madvise(addr, $size, MADV_WILLNEED);
+                #endif
+
+                return { true, "" };
+            }
+
+            /**
+             * Unmap the file.
+            */
+            void close() {
+                #ifdef _WIN32
+                if ($data) UnmapViewOfFile($data);
+                if ($mapping) CloseHandle($mapping);
+                if ($file != INVALID_HANDLE_VALUE) CloseHandle($file);
+                $mapping = nullptr;
+                $file = INVALID_HANDLE_VALUE;
+                #else
+                if ($data) munmap(const_cast<uint8_t*>($data), $size);
+                if ($fd >= 0) ::close($fd);
+                $fd = -1;
+                #endif
+                $data = nullptr;
+                $size = 0;
+            }
+
+            /**
+             * Whether a file is mapped. Empty files count as mapped.
+            */
+            bool isOpen() const {
+                #ifdef _WIN32
+                return $file != INVALID_HANDLE_VALUE;
+                #else
+                return $fd >= 0;
+                #endif
+            }
+
+            /**
+             * Get the file's contents, nullptr for empty files.
+            */
+            const uint8_t* data() const {
+                return $data;
+            }
+
+            /**
+             * Get the file's size in bytes.
+            */
+            size_t size() const {
+                return $size;
+            }
+
+            private:
+                const uint8_t* $data = nullptr;
+                size_t $size = 0;
+                #ifdef _WIN32
+                HANDLE $file = INVALID_HANDLE_VALUE;
+                HANDLE $mapping = nullptr;
+                #else
+                int $fd = -1;
+                #endif
+        };
+
+        /**
+         * How hard AtomicWriter::commit works to make a save survive a crash
+         * or power loss.
+        */
+        enum class Durability {
+            /**
+             * Leave flushing to the OS. A crash can't leave a half-written
+             * file, but a power loss may lose the save or leave it empty.
+            */
+            None,
+            /**
+             * Flush the file's data to disk before it replaces the old one.
+            */
+            Data,
+            /**
+             * Also flush the directory, so the rename itself is on disk
+             * when commit returns.
+            */
+            Full
+        };
+
+        /**
+         * Replaces a file atomically: everything is written to a temporary
+         * file next to the target, which is renamed over the target on
+         * commit. Readers and crashes see either the old file or the new
+         * one, never a mix. Writes are handed to a background thread, so
+         * the caller can keep producing data while earlier data goes to
+         * disk.
+        */
+        struct AtomicWriter {
+            /**
+             * Size of the buffers handed to the writer thread.
+            */
+            static constexpr size_t BufferSize = 0x100000;
+            /**
+             * Amount of full buffers that may wait for the writer thread
+             * before AtomicWriter::write blocks.
+            */
+            static constexpr size_t MaxQueued = 4;
+
+            /**
+             * Create the temporary file and start the writer thread. Check
+             * isOpen() for success.
+             * @param path The file to replace
+             * @param durability See Durability
+            */
+            AtomicWriter(const std::string & path, Durability durability = Durability::Data)
+              : $path(path), $tmp(path + ".tmp"), $durability(durability) {
+                #ifdef _WIN32
+                $file = CreateFileA(
+                    $tmp.c_str(), GENERIC_WRITE, 0, nullptr,
+                    CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr
+                );
+                if ($file == INVALID_HANDLE_VALUE)
+                    return;
+                #else
+                // keep the permissions of the file being replaced
+                struct stat st;
+                mode_t mode = ::stat(path.c_str(), &st) == 0 ? (st.st_mode & 07777) : 0644;
+                $fd = ::open($tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+                if ($fd < 0)
+                    return;
+                ::fchmod($fd, mode);
+                #endif
+
+                $current.reserve(BufferSize);
+                $thread = std::thread([this]() -> void { this->run(); });
+            }
+
+            AtomicWriter(const AtomicWriter &) = delete;
+            AtomicWriter & operator= (const AtomicWriter &) = delete;
+
+            /**
+             * Throws the temporary file away unless commit succeeded.
+            */
+            ~AtomicWriter() {
+                this->discard();
+            }
+
+            /**
+             * Whether the temporary file could be created.
+            */
+            bool isOpen() const {
+                #ifdef _WIN32
+                return $file != INVALID_HANDLE_VALUE;
+                #else
+                return $fd >= 0;
+                #endif
+            }
+
+            /**
+             * Queue data to be written. Blocks only if the writer thread
+             * is MaxQueued buffers behind.
+             * @returns false if writing has failed
+            */
+            bool write(const uint8_t* data, size_t size) {
+                if (!this->isOpen() || $failed) return false;
+
+                while (size) {
+                    size_t len = std::min(size, BufferSize - $current.size());
+                    $current.insert($current.end(), data, data + len);
+                    data += len;
+                    size -= len;
+                    if ($current.size() == BufferSize)
+                        this->push();
+                }
+                return !$failed;
+            }
+
+            /**
+             * Write out everything, flush according to the durability
+             * policy and rename the temporary file over the target.
+             * @returns gdshare::Result
+            */
+            Result commit() {
+                if (!this->isOpen())
+                    return { false, "Unable to create " + $tmp };
+
+                this->push();
+                this->stop();
+
+                bool ok = !$failed;
+                #ifdef _WIN32
+                if (ok && $durability != Durability::None)
+                    ok = FlushFileBuffers($file);
+                CloseHandle($file);
+                $file = INVALID_HANDLE_VALUE;
+
+                DWORD flags = MOVEFILE_REPLACE_EXISTING;
+                if ($durability != Durability::None) flags |= MOVEFILE_WRITE_THROUGH;
+                if (ok && !MoveFileExA($tmp.c_str(), $path.c_str(), flags))
+                    return this->fail("Unable to replace " + $path);
+                #else
+                if (ok && $durability != Durability::None)
+                    ok = ::fsync($fd) == 0;
+                ok = ::close($fd) == 0 && ok;
+                $fd = -1;
+
+                if (ok && ::rename($tmp.c_str(), $path.c_str()) != 0)
+                    return this->fail("Unable to replace " + $path);
+
+                if (ok && $durability == Durability::Full) {
+                    auto dir = std::filesystem::path($path).parent_path();
+                    int dfd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_CLOEXEC);
+                    if (dfd >= 0) {
+                        ::fsync(dfd);
+                        ::close(dfd);
+                    }
+                }
+                #endif
+
+                if (!ok)
+                    return this->fail("Unable to write " + $tmp);
+
+                $committed = true;
+                return { true, "" };
+            }
+
+            /**
+             * Stop writing and delete the temporary file. The target is
+             * left untouched. Does nothing after a successful commit.
+            */
+            void discard() {
+                if ($committed) return;
+                this->stop();
+                #ifdef _WIN32
+                if ($file != INVALID_HANDLE_VALUE) {
+                    CloseHandle($file);
+                    $file = INVALID_HANDLE_VALUE;
+                    DeleteFileA($tmp.c_str());
+                }
+                #else
+                if ($fd >= 0) {
+                    ::close($fd);
+                    $fd = -1;
+                    ::unlink($tmp.c_str());
+                }
+                #endif
+            }
+
+            private:
+                Result fail(const std::string & info) {
+                    #ifdef _WIN32
+                    DeleteFileA($tmp.c_str());
+                    #else
+                    ::unlink($tmp.c_str());
+                    #endif
+                    return { false, info };
+                }
+
+                /**
+                 * Hand the current buffer to the writer thread.
+                */
+                void push() {
+                    if ($current.empty()) return;
+
+                    std::vector<uint8_t> next;
+                    {
+                        std::unique_lock<std::mutex> lock ($mutex);
+                        $space.wait(lock, [this]() { return $queue.size() < MaxQueued || $failed; });
+                        $queue.push_back(std::move($current));
+                        if (!$spare.empty()) {
+                            next = std::move($spare.back());
+                            $spare.pop_back();
+                        }
+                    }
+                    $ready.notify_one();
+
+                    next.clear();
+                    next.reserve(BufferSize);
+                    $current = std::move(next);
+                }
+
+                /**
+                 * Let the writer thread finish the queue and join it.
+                */
+                void stop() {
+                    if (!$thread.joinable()) return;
+                    {
+                        std::lock_guard<std::mutex> lock ($mutex);
+                        $done = true;
+                    }
+                    $ready.notify_one();
+                    $thread.join();
+                }
+
+                void run() {
+                    for (;;) {
+                        std::vector<uint8_t> buf;
+                        {
+                            std::unique_lock<std::mutex> lock ($mutex);
+                            $ready.wait(lock, [this]() { return $done || !$queue.empty(); });
+                            if ($queue.empty())
+                                return;
+                            buf = std::move($queue.front());
+                            $queue.pop_front();
+                        }
+
+                        bool ok = !$failed && this->writeAll(buf.data(), buf.size());
+                        {
+                            std::lock_guard<std::mutex> lock ($mutex);
+                            if (!ok) $failed = true;
+                            $spare.push_back(std::move(buf));
+                        }
+                        $space.notify_one();
+                    }
+                }
+
+                bool writeAll(const uint8_t* data, size_t size) {
+                    while (size) {
+                        #ifdef _WIN32
+                        DWORD written = 0;
+                        DWORD len = static_cast<DWORD>(std::min<size_t>(size, 0x40000000));
+                        if (!WriteFile($file, data, len, &written, nullptr))
+                            return false;
+                        #else
+                        ssize_t written = ::write($fd, data, size);
+                        if (written < 0) {
+                            if (errno == EINTR) continue;
+                            return false;
+                        }
+                        #endif
+                        data += written;
+                        size -= static_cast<size_t>(written);
+                    }
+                    return true;
+                }
+
+                std::string $path;
+                std::string $tmp;
+                Durability $durability;
+                #ifdef _WIN32
+                HANDLE $file = INVALID_HANDLE_VALUE;
+                #else
+                int $fd = -1;
+                #endif
+
+                std::vector<uint8_t> $current;
+                std::deque<std::vector<uint8_t>> $queue;
+                std::vector<std::vector<uint8_t>> $spare;
+                std::thread $thread;
+                std::mutex $mutex;
+                std::condition_variable $ready;
+                std::condition_variable $space;
+                std::atomic<bool> $failed = false;
+                bool $done = false;
+                bool $committed = false;
+        };
+
+        /**
+         * XXH64 hash of a buffer. Fast enough to fingerprint a whole save
+         * file in a fraction of the time decoding it takes.
+         * @param data The data to hash
+         * @param size Size of the data in bytes
+         * @param seed Hash seed
+         * @returns 64-bit hash
+        */
+        inline uint64_t hash64(const uint8_t* data, size_t size, uint64_t seed = 0) {
+            constexpr uint64_t P1 = 0x9E3779B185EBCA87ull;
+            constexpr uint64_t P2 = 0xC2B2AE3D27D4EB4Full;
+            constexpr uint64_t P3 = 0x165667B19E3779F9ull;
+            constexpr uint64_t P4 = 0x85EBCA77C2B2AE63ull;
+            constexpr uint64_t P5 = 0x27D4EB2F165667C5ull;
+
+            auto rotl = [](uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+            auto read64 = [](const uint8_t* p) { uint64_t v; std::memcpy(&v, p, 8); return v; };
+            auto read32 = [](const uint8_t* p) { uint32_t v; std::memcpy(&v, p, 4); return static_cast<uint64_t>(v); };
+            auto round = [rotl](uint64_t acc, uint64_t in) { return rotl(acc + in * P2, 31) * P1; };
+            auto merge = [round](uint64_t acc, uint64_t v) { return (acc ^ round(0, v)) * P1 + P4; };
+
+            const uint8_t* p = data;
+            const uint8_t* end = data + size;
+            uint64_t h;
+
+            if (size >= 32) {
+                uint64_t v1 = seed + P1 + P2, v2 = seed + P2, v3 = seed, v4 = seed - P1;
+                for (; p + 32 <= end; p += 32) {
+                    v1 = round(v1, read64(p));
+                    v2 = round(v2, read64(p + 8));
+                    v3 = round(v3, read64(p + 16));
+                    v4 = round(v4, read64(p + 24));
+                }
+                h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+                h = merge(merge(merge(merge(h, v1), v2), v3), v4);
+            } else
+                h = seed + P5;
+
+            h += static_cast<uint64_t>(size);
+
+            for (; p + 8 <= end; p += 8)
+                h = rotl(h ^ round(0, read64(p)), 27) * P1 + P4;
+            if (p + 4 <= end) {
+                h = rotl(h ^ (read32(p) * P1), 23) * P2 + P3;
+                p += 4;
+            }
+            for (; p < end; p++)
+                h = rotl(h ^ (*p * P5), 11) * P1;
+
+            h ^= h >> 33;
+            h *= P2;
+            h ^= h >> 29;
+            h *= P3;
+            h ^= h >> 32;
+            return h;
+        }
+
+        /**
+         * Identifies one version of a file on disk.
+        */
+        struct FileIdentity {
+            std::string path;
+            uint64_t size;
+            int64_t mtime;
+            uint64_t hash;
+
+            /**
+             * Get the identity of a file whose contents are already in memory.
+             * @param path The file's path
+             * @param data The file's contents
+             * @param size Size of the contents in bytes
+            */
+            static FileIdentity of(const std::string & path, const uint8_t* data, size_t size) {
+                std::error_code err;
+                auto time = std::filesystem::last_write_time(path, err);
+                int64_t mtime = err ? 0 : static_cast<int64_t>(time.time_since_epoch().count());
+
+                auto full = std::filesystem::absolute(path, err);
+                return {
+                    err ? path : full.string(),
+                    static_cast<uint64_t>(size),
+                    mtime,
+                    hash64(data, size)
+                };
+            }
+
+            /**
+             * Write the identity in binary form.
+            */
+            void write(std::ostream & out) const {
+                uint32_t pathSize = static_cast<uint32_t>(path.size());
+                out.write(reinterpret_cast<const char*>(&size), sizeof size);
+                out.write(reinterpret_cast<const char*>(&mtime), sizeof mtime);
+                out.write(reinterpret_cast<const char*>(&hash), sizeof hash);
+                out.write(reinterpret_cast<const char*>(&pathSize), sizeof pathSize);
+                out.write(path.data(), pathSize);
+            }
+
+            /**
+             * Read an identity written with FileIdentity::write.
+             * @returns false if the stream ended or is corrupt
+            */
+            bool read(std::istream & in) {
+                uint32_t pathSize = 0;
+                in.read(reinterpret_cast<char*>(&size), sizeof size);
+                in.read(reinterpret_cast<char*>(&mtime), sizeof mtime);
+                in.read(reinterpret_cast<char*>(&hash), sizeof hash);
+                in.read(reinterpret_cast<char*>(&pathSize), sizeof pathSize);
+                if (!in || pathSize > 0x10000)
+                    return false;
+
+                path.resize(pathSize);
+                in.read(&path[0], pathSize);
+                return static_cast<bool>(in);
+            }
+
+            bool operator== (const FileIdentity & other) const {
+                return path == other.path && size == other.size &&
+                    mtime == other.mtime && hash == other.hash;
+            }
+        };
+
+        /**
+         * Get how many bytes are left in a stream, so lengths read from a
+         * file can be checked before anything is allocated for them.
+         * @returns The byte count, 0 if the stream can't seek
+        */
+        inline uint64_t remaining(std::istream & in) {
+            auto pos = in.tellg();
+            if (pos < 0) return 0;
+            in.seekg(0, std::ios::end);
+            auto end = in.tellg();
+            in.seekg(pos);
+            return end < pos ? 0 : static_cast<uint64_t>(end - pos);
+        }
+
+        /**
+         * Opt-in on-disk cache of decoded saves. Entries are keyed by
+         * FileIdentity, so a changed file never hits a stale entry.
+         * Enable by setting GDSHARE_CACHE=1 in the environment.
+        */
+        struct DecodeCache {
+            static constexpr uint32_t Magic = 0x43534447; // "GDSC"
+            static constexpr uint32_t Version = 2;
+
+            /**
+             * Whether the cache is enabled.
+            */
+            static bool enabled() {
+                const char* env = std::getenv("GDSHARE_CACHE");
+                return env && *env && std::string(env) != "0";
+            }
+
+            /**
+             * Get the cache directory: $XDG_CACHE_HOME/gdshare (or
+             * ~/.cache/gdshare), %LOCALAPPDATA%/gdshare/cache on Windows.
+             * @returns The directory, or an empty path if there is none
+            */
+            static std::filesystem::path directory() {
+                #ifdef _WIN32
+                if (const char* dir = std::getenv("LOCALAPPDATA"))
+                    return std::filesystem::path(dir) / "gdshare" / "cache";
+                #else
+                if (const char* dir = std::getenv("XDG_CACHE_HOME"))
+                    if (*dir) return std::filesystem::path(dir) / "gdshare";
+                if (const char* home = std::getenv("HOME"))
+                    return std::filesystem::path(home) / ".cache" / "gdshare";
+                #endif
+                return {};
+            }
+
+            /**
+             * Get the cache entry path for a file.
+             * @param path The save file's path
+             * @param ext Extension of the entry, for sidecars next to the XML
+            */
+            static std::filesystem::path entry(const std::string & path, const char* ext = ".xml") {
+                auto dir = directory();
+                if (dir.empty()) return {};
+
+                char name[48];
+                std::snprintf(name, sizeof name, "%016llx%s",
+                    static_cast<unsigned long long>(hash64(reinterpret_cast<const uint8_t*>(path.data()), path.size())), ext);
+                return dir / name;
+            }
+
+            /**
+             * Load a decoded save from the cache.
+             * @param id Identity of the save file
+             * @param out Receives the decoded XML
+             * @returns true on a hit, false if there's no valid entry
+            */
+            static bool load(const FileIdentity & id, std::string & out) {
+                auto file = entry(id.path);
+                if (file.empty()) return false;
+
+                std::ifstream in (file, std::ios::binary);
+                if (!in.is_open()) return false;
+
+                FileIdentity cached;
+                uint64_t length = 0;
+                if (!readHeader(in, cached, length) || !(cached == id))
+                    return false;
+                if (length > remaining(in))
+                    return false;
+
+                out.resize(length);
+                in.read(&out[0], length);
+                return static_cast<bool>(in);
+            }
+
+            /**
+             * Store a decoded save in the cache. The entry is written to
+             * a temporary file and renamed, so readers never see half of it.
+             * @param id Identity of the save file
+             * @param decoded The decoded XML
+             * @returns true if the entry was written
+            */
+            static bool store(const FileIdentity & id, const std::string & decoded) {
+                auto file = entry(id.path);
+                if (file.empty()) return false;
+
+                std::error_code err;
+                std::filesystem::create_directories(file.parent_path(), err);
+
+                auto tmp = file;
+                tmp += ".tmp";
+                {
+                    std::ofstream out (tmp, std::ios::binary | std::ios::trunc);
+                    if (!out.is_open()) return false;
+
+                    auto put = [&out](auto value) {
+                        out.write(reinterpret_cast<const char*>(&value), sizeof value);
+                    };
+                    put(Magic);
+                    put(Version);
+                    id.write(out);
+                    put(static_cast<uint64_t>(decoded.size()));
+                    out.write(decoded.data(), decoded.size());
+                    if (!out) return false;
+                }
+
+                std::filesystem::rename(tmp, file, err);
+                return !err;
+            }
+
+            private:
+                static bool readHeader(std::istream & in, FileIdentity & id, uint64_t & length) {
+                    auto get = [&in](auto & value) {
+                        in.read(reinterpret_cast<char*>(&value), sizeof value);
+                    };
+                    uint32_t magic = 0, version = 0;
+                    get(magic);
+                    get(version);
+                    if (!in || magic != Magic || version != Version)
+                        return false;
+
+                    if (!id.read(in))
+                        return false;
+                    get(length);
+                    return static_cast<bool>(in);
+                }
+        };
+    }
+}
@@ -0,0 +1,429 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <algorithm>
+#include <system_error>
+#include <cstdlib>
+#include "gdshare.hpp"
+
+// on Windows, this has to come before Windows.h so winsock.h doesn't get
+// pulled in first
+#ifdef _WIN32
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <winsock2.h>
+    #include <afunix.h>
+    #include <Windows.h>
+    #pragma comment(lib, "ws2_32")
+    #pragma comment(lib, "advapi32")
+    #ifndef SIO_AF_UNIX_GETPEERPID
+        #define SIO_AF_UNIX_GETPEERPID _WSAIOR(IOC_VENDOR, 256)
+    #endif
+#else
+    #include <sys/socket.h>
+    #include <sys/stat.h>
+    #include <sys/time.h>
+    #include <sys/un.h>
+    #include <poll.h>
+    #include <unistd.h>
+#endif
+
+namespace gdshare {
+    /**
+     * Local inter-process messaging over Unix domain sockets (AF_UNIX,
+     * available on Windows 10 1803 and later through afunix.h).
+     *
+     * A message is a list of strings: a 32-bit count, then every string as
+     * a 32-bit length followed by its bytes, all little-endian.
+    */
+    namespace ipc {
+        #ifdef _WIN32
+            using Handle = SOCKET;
+            static constexpr Handle Invalid = INVALID_SOCKET;
+        #else
+            using Handle = int;
+            static constexpr Handle Invalid = -1;
+        #endif
+
+        using Message = std::vector<std::string>;
+
+        namespace detail {
+            inline bool startup() {
+                #ifdef _WIN32
+                    static bool ok = []() {
+                        WSADATA data;
+                        return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+                    }();
+                    return ok;
+                #else
+                    return true;
+                #endif
+            }
+
+            inline void closeHandle(Handle handle) {
+                #ifdef _WIN32
+                    closesocket(handle);
+                #else
+                    ::close(handle);
+                #endif
+            }
+
+            inline bool address(const std::string & path, sockaddr_un & addr) {
+                std::memset(&addr, 0, sizeof addr);
+                addr.sun_family = AF_UNIX;
+                if (path.empty() || path.size() >= sizeof addr.sun_path)
+                    return false;
+                std::memcpy(addr.sun_path, path.data(), path.size());
+                return true;
+            }
+
+            // largest message accepted, to not trust a length blindly
+            static constexpr uint32_t MaxSize = 256u << 20;
+
+            #ifdef _WIN32
+                /**
+                 * Get the user a process runs as.
+                 * @param buffer Holds the result
+                 * @returns The user's SID, or nullptr on failure
+                */
+                inline PSID processUser(HANDLE process, std::vector<uint8_t> & buffer) {
+                    HANDLE token;
+                    if (!OpenProcessToken(process, TOKEN_QUERY, &token))
+                        return nullptr;
+
+                    DWORD size = 0;
+                    GetTokenInformation(token, TokenUser, nullptr, 0, &size);
+                    buffer.resize(size);
+                    bool ok = size && GetTokenInformation(token, TokenUser, buffer.data(), size, &size);
+                    CloseHandle(token);
+                    return ok ? reinterpret_cast<TOKEN_USER*>(buffer.data())->User.Sid : nullptr;
+                }
+            #else
+                /**
+                 * Check that a directory belongs to this user alone and
+                 * isn't a symlink.
+                */
+                inline bool isPrivate(const std::string & dir) {
+                    struct stat st;
+                    return ::lstat(dir.c_str(), &st) == 0 && S_ISDIR(st.st_mode) &&
+                        st.st_uid == ::geteuid() && (st.st_mode & 077) == 0;
+                }
+            #endif
+        }
+
+        /**
+         * Get a directory only the current user can access, for sockets:
+         * $XDG_RUNTIME_DIR, or a gdshare-<uid> directory with mode 0700 in
+         * the temp directory. On Windows, %LOCALAPPDATA%/gdshare, which is
+         * in the user's profile.
+         * @returns The directory, or "" if there's no safe one
+        */
+        inline std::string privateDir() {
+            std::error_code err;
+            #ifdef _WIN32
+                const char* appdata = std::getenv("LOCALAPPDATA");
+                if (!appdata || !*appdata) return "";
+                auto dir = std::filesystem::path(appdata) / "gdshare";
+                std::filesystem::create_directories(dir, err);
+                return err ? "" : dir.string();
+            #else
+                if (const char* runtime = std::getenv("XDG_RUNTIME_DIR"))
+                    if (*runtime && detail::isPrivate(runtime))
+                        return runtime;
+
+                auto tmp = std::filesystem::temp_directory_path(err);
+                if (err) return "";
+                auto dir = (tmp / ("gdshare-" + std::to_string(::geteuid()))).string();
+                // an existing directory has to pass the same check, so
+                // nobody else can have made it first
+                ::mkdir(dir.c_str(), 0700);
+                return detail::isPrivate(dir) ? dir : "";
+            #endif
+        }
+
+        /**
+         * A connected socket.
+        */
+        struct Socket {
+            Socket() = default;
+            explicit Socket(Handle handle) : $handle(handle) {}
+
+            Socket(const Socket &) = delete;
+            Socket & operator= (const Socket &) = delete;
+
+            Socket(Socket && other) noexcept : $handle(other.$handle) {
+                other.$handle = Invalid;
+            }
+
+            Socket & operator= (Socket && other) noexcept {
+                if (this != &other) {
+                    this->close();
+                    $handle = other.$handle;
+                    other.$handle = Invalid;
+                }
+                return *this;
+            }
+
+            ~Socket() {
+                this->close();
+            }
+
+            bool isOpen() const {
+                return $handle != Invalid;
+            }
+
+            Handle handle() const {
+                return $handle;
+            }
+
+            void close() {
+                if ($handle != Invalid)
+                    detail::closeHandle($handle);
+                $handle = Invalid;
+            }
+
+            /**
+             * Give up on sends and receives that take longer than this.
+             * @param ms Milliseconds, 0 to wait forever
+             * @returns false if the timeout couldn't be set
+            */
+            bool timeout(int ms) {
+                #ifdef _WIN32
+                    DWORD val = static_cast<DWORD>(ms);
+                    auto opt = reinterpret_cast<const char*>(&val);
+                #else
+                    timeval val { ms / 1000, (ms % 1000) * 1000 };
+                    auto opt = &val;
+                #endif
+                return ::setsockopt($handle, SOL_SOCKET, SO_RCVTIMEO, opt, sizeof val) == 0 &&
+                    ::setsockopt($handle, SOL_SOCKET, SO_SNDTIMEO, opt, sizeof val) == 0;
+            }
+
+            /**
+             * Whether the process on the other end runs as the same user
+             * as this one.
+            */
+            bool peerIsSelf() const {
+                #ifdef _WIN32
+                    ULONG pid = 0;
+                    DWORD bytes = 0;
+                    if (WSAIoctl($handle, SIO_AF_UNIX_GETPEERPID, nullptr, 0, &pid, sizeof pid, &bytes, nullptr, nullptr) != 0)
+                        return false;
+
+                    HANDLE peer = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+                    if (!peer) return false;
+                    std::vector<uint8_t> mine, theirs;
+                    PSID self = detail::processUser(GetCurrentProcess(), mine);
+                    PSID other = detail::processUser(peer, theirs);
+                    CloseHandle(peer);
+                    return self && other && EqualSid(self, other);
+                #elif defined(SO_PEERCRED)
+                    ucred cred;
+                    socklen_t len = sizeof cred;
+                    return ::getsockopt($handle, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0 &&
+                        cred.uid == ::geteuid();
+                #else
+                    uid_t uid;
+                    gid_t gid;
+                    return ::getpeereid($handle, &uid, &gid) == 0 && uid == ::geteuid();
+                #endif
+            }
+
+            /**
+             * Send a message.
+             * @returns false if the connection failed
+            */
+            bool send(const Message & msg) {
+                std::string out;
+                putU32(out, static_cast<uint32_t>(msg.size()));
+                for (auto & str : msg) {
+                    putU32(out, static_cast<uint32_t>(str.size()));
+                    out += str;
+                }
+                return this->write(out.data(), out.size());
+            }
+
+            /**
+             * Receive a message, waiting until it's complete.
+             * @returns false if the connection was closed or the data was
+             * malformed
+            */
+            bool receive(Message & msg) {
+                msg.clear();
+                uint32_t count;
+                if (!this->getU32(count) || count > detail::MaxSize)
+                    return false;
+                for (uint32_t ix = 0; ix < count; ix++) {
+                    uint32_t len;
+                    if (!this->getU32(len) || len > detail::MaxSize)
+                        return false;
+                    std::string str (len, '\0');
+                    if (len && !this->read(str.data(), len))
+                        return false;
+                    msg.push_back(std::move(str));
+                }
+                return true;
+            }
+
+            protected:
+                static void putU32(std::string & out, uint32_t value) {
+                    for (int ix = 0; ix < 4; ix++)
+                        out += static_cast<char>((value >> (ix * 8)) & 0xff);
+                }
+
+                bool getU32(uint32_t & value) {
+                    uint8_t bytes[4];
+                    if (!this->read(reinterpret_cast<char*>(bytes), 4))
+                        return false;
+                    value = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+                    return true;
+                }
+
+                bool write(const char* data, size_t size) {
+                    while (size) {
+                        #ifdef _WIN32
+                            int sent = ::send($handle, data, static_cast<int>(std::min<size_t>(size, 0x40000000)), 0);
+                        #else
+                            ssize_t sent = ::send($handle, data, size, MSG_NOSIGNAL);
+                        #endif
+                        if (sent <= 0) return false;
+                        data += sent;
+                        size -= static_cast<size_t>(sent);
+                    }
+                    return true;
+                }
+
+                bool read(char* data, size_t size) {
+                    while (size) {
+                        #ifdef _WIN32
+                            int got = ::recv($handle, data, static_cast<int>(std::min<size_t>(size, 0x40000000)), 0);
+                        #else
+                            ssize_t got = ::recv($handle, data, size, 0);
+                        #endif
+                        if (got <= 0) return false;
+                        data += got;
+                        size -= static_cast<size_t>(got);
+                    }
+                    return true;
+                }
+
+                Handle $handle = Invalid;
+        };
+
+        /**
+         * Connect to a listening socket.
+         * @param path The socket's path
+         * @returns The connection; isOpen() is false if nothing is
+         * listening there
+        */
+        inline Socket connect(const std::string & path) {
+            sockaddr_un addr;
+            if (!detail::startup() || !detail::address(path, addr))
+                return Socket();
+
+            Socket sock (::socket(AF_UNIX, SOCK_STREAM, 0));
+            if (!sock.isOpen())
+                return sock;
+            if (::connect(sock.handle(), reinterpret_cast<sockaddr*>(&addr), sizeof addr) != 0)
+                sock.close();
+            return sock;
+        }
+
+        /**
+         * A socket accepting connections. The socket file is removed again
+         * when the listener is destroyed.
+        */
+        struct Listener {
+            Listener() = default;
+            Listener(const Listener &) = delete;
+            Listener & operator= (const Listener &) = delete;
+
+            ~Listener() {
+                this->close();
+            }
+
+            /**
+             * Start listening. A stale socket file left behind by a crashed
+             * server is replaced; a live one is an error.
+             * @param path Where to create the socket
+             * @returns gdshare::Result
+            */
+            Result listen(const std::string & path) {
+                this->close();
+
+                sockaddr_un addr;
+                if (!detail::startup())
+                    return { false, "Unable to initialize sockets" };
+                if (!detail::address(path, addr))
+                    return { false, "Socket path \"" + path + "\" is too long" };
+
+                std::error_code err;
+                if (std::filesystem::exists(path, err)) {
+                    if (connect(path).isOpen())
+                        return { false, "A server is already listening on " + path };
+                    std::filesystem::remove(path, err);
+                }
+
+                $handle = ::socket(AF_UNIX, SOCK_STREAM, 0);
+                if ($handle == Invalid)
+                    return { false, "Unable to create socket" };
+
+                if (::bind($handle, reinterpret_cast<sockaddr*>(&addr), sizeof addr) != 0 ||
+                    ::listen($handle, 16) != 0) {
+                    this->close();
+                    return { false, "Unable to listen on " + path };
+                }
+                #ifndef _WIN32
+                    ::chmod(path.c_str(), 0600);
+                #endif
+
+                $path = path;
+                return { true, "" };
+            }
+
+            /**
+             * Wait for a connection.
+             * @param timeout Milliseconds to wait, -1 to wait forever
+             * @returns The connection; isOpen() is false on timeout or error
+            */
+            Socket accept(int timeout = -1) {
+                if ($handle == Invalid)
+                    return Socket();
+
+                #ifdef _WIN32
+                    WSAPOLLFD pfd { $handle, POLLRDNORM, 0 };
+                    if (WSAPoll(&pfd, 1, timeout) <= 0)
+                        return Socket();
+                #else
+                    pollfd pfd { $handle, POLLIN, 0 };
+                    if (::poll(&pfd, 1, timeout) <= 0)
+                        return Socket();
+                #endif
+                return Socket(::accept($handle, nullptr, nullptr));
+            }
+
+            bool isOpen() const {
+                return $handle != Invalid;
+            }
+
+            void close() {
+                if ($handle == Invalid) return;
+                detail::closeHandle($handle);
+                $handle = Invalid;
+
+                std::error_code err;
+                std::filesystem::remove($path, err);
+                $path.clear();
+            }
+
+            protected:
+                Handle $handle = Invalid;
+                std::string $path;
+        };
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+
+namespace gdshare {
+    /**
+     * Level keys known at compile time. Replaces string lookups into
+     * Level::Keys with enum values that map to the GD key directly.
+    */
+    enum class Key : uint8_t {
+        Id,
+        Name,
+        Description,
+        Data,
+        Creator,
+        OfficialSong,
+        Version,
+        Attempts,
+        Percentage,
+        Length,
+        Jumps,
+        CustomSong,
+        EditorTime,
+        None
+    };
+
+    namespace keys {
+        /**
+         * One entry of the key table.
+        */
+        struct Entry {
+            Key key;
+            std::string_view name;  // human-readable name, as in Level::Keys
+            std::string_view gd;    // the key in the save
+            bool number;            // whether the value is an integer
+        };
+
+        /**
+         * All known keys, in Key order.
+        */
+        inline constexpr Entry Table[] = {
+            { Key::Id,           "id",            "k1",  true  },
+            { Key::Name,         "name",          "k2",  false },
+            { Key::Description,  "description",   "k3",  false },
+            { Key::Data,         "data",          "k4",  false },
+            { Key::Creator,      "creator",       "k5",  false },
+            { Key::OfficialSong, "official-song", "k8",  true  },
+            { Key::Version,      "version",       "k16", true  },
+            { Key::Attempts,     "attempts",      "k18", true  },
+            { Key::Percentage,   "percentage",    "k19", true  },
+            { Key::Length,       "length",        "k23", true  },
+            { Key::Jumps,        "jumps",         "k36", true  },
+            { Key::CustomSong,   "custom-song",   "k45", true  },
+            { Key::EditorTime,   "editor-time",   "k80", true  },
+        };
+
+        inline constexpr size_t Count = sizeof(Table) / sizeof(Table[0]);
+        static_assert(Count == static_cast<size_t>(Key::None), "key table out of sync with Key");
+
+        constexpr bool ordered() {
+            for (size_t ix = 0; ix < Count; ix++)
+                if (static_cast<size_t>(Table[ix].key) != ix) return false;
+            return true;
+        }
+        static_assert(ordered(), "key table must be in Key order");
+
+        /**
+         * Get the GD key of a Key, e.g. "k80" for Key::EditorTime.
+        */
+        constexpr std::string_view gd(Key key) {
+            return key < Key::None ? Table[static_cast<size_t>(key)].gd : std::string_view();
+        }
+
+        /**
+         * Get the human-readable name of a Key, e.g. "editor-time".
+        */
+        constexpr std::string_view name(Key key) {
+            return key < Key::None ? Table[static_cast<size_t>(key)].name : std::string_view();
+        }
+
+        /**
+         * Whether a key's value is an integer.
+        */
+        constexpr bool number(Key key) {
+            return key < Key::None && Table[static_cast<size_t>(key)].number;
+        }
+    }
+}
@@ -0,0 +1,215 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <cstdint>
+#include <filesystem>
+#include "gdshare.hpp"
+#include "gdshare-codec.hpp"
+#include "gdshare-io.hpp"
+#include "gdshare-keys.hpp"
+#include "gdshare-view.hpp"
+#include "gdshare-xml.hpp"
+
+namespace gdshare {
+    /**
+     * Reads and writes single level files without the prebuilt library,
+     * so the work can run on any thread. A .gmd file holds the level's
+     * XML, the same text as in the save; a .lvl file holds that text
+     * gzipped. .gmd2 files are zip archives and are left to
+     * Level::exportTo and Level::load.
+    */
+    namespace levelfile {
+        /**
+         * Whether files of a type can be written here rather than by
+         * Level::exportTo.
+         * @param type One of gdshare::filetypes
+        */
+        inline bool handles(std::string_view type) {
+            return type == filetypes::GDShare || type == filetypes::LvlShare;
+        }
+
+        /**
+         * Figure out which file a level gets exported to, the same way
+         * Level::exportTo does: an empty path means the current directory,
+         * and a directory gets a file named after the level.
+         * @param name The level's name
+         * @param path The path passed to the export
+         * @param type One of gdshare::filetypes
+         * @returns The file to write
+        */
+        inline std::string target(std::string_view name, const std::string & path, std::string_view type) {
+            std::error_code err;
+            if (!path.empty() && !std::filesystem::is_directory(path, err))
+                return path;
+
+            // characters Windows doesn't allow in file names
+            std::string file (name);
+            for (auto & c : file)
+                if (std::strchr("<>:\"/\\|?*", c) || static_cast<unsigned char>(c) < 32)
+                    c = '_';
+            file += '.';
+            file += type;
+
+            return path.empty() ? file : (std::filesystem::path(path) / file).string();
+        }
+
+        /**
+         * Turn a level into the contents of a level file. Only reads the
+         * level's XML, so levels can be packed in parallel.
+         * @param level The level's <d> node
+         * @param type gdshare::filetypes::GDShare or LvlShare
+         * @param compression zlib compression level for .lvl files
+         * @returns The file's contents, or an empty vector on failure
+        */
+        inline std::vector<uint8_t> pack(
+            const rapidxml::xml_node<>* level, std::string_view type,
+            int compression = Z_DEFAULT_COMPRESSION
+        ) {
+            std::vector<uint8_t> text;
+            xml::Writer writer ([&text](const uint8_t* data, size_t size) -> bool {
+                text.insert(text.end(), data, data + size);
+                return true;
+            });
+            writer.print(level);
+            writer.finish();
+
+            if (type == filetypes::GDShare)
+                return text;
+            if (type != filetypes::LvlShare)
+                return {};
+
+            codec::GZipOptions options;
+            options.level = compression;
+            // callers already spread levels over threads
+            options.threads = 1;
+            return codec::GZip(text.data(), text.size(), options);
+        }
+
+        /**
+         * Write a packed level to disk. The file is only replaced once it
+         * has been written completely.
+         * @param path The file to write
+         * @param data The file's contents, see levelfile::pack
+         * @returns gdshare::Result
+        */
+        inline Result write(const std::string & path, const std::vector<uint8_t> & data) {
+            io::AtomicWriter file (path, io::Durability::None);
+            if (!file.isOpen())
+                return { false, "Unable to open " + path + " for writing" };
+            if (!file.write(data.data(), data.size())) {
+                file.discard();
+                return { false, "Unable to write " + path };
+            }
+            return file.commit();
+        }
+
+        /**
+         * A level read from a file. Owns the XML the level lives in.
+        */
+        struct Loaded {
+            std::unique_ptr<rapidxml::xml_document<>> doc;
+            /**
+             * The level's <d> node, nullptr if reading failed
+            */
+            rapidxml::xml_node<>* level = nullptr;
+            /**
+             * Whether the file is a zip (.gmd2), which has to go
+             * through Level::load instead
+            */
+            bool zipped = false;
+        };
+
+        /**
+         * Read, decode and check a level file. Doesn't touch the prebuilt
+         * library, so files can be read in parallel. Accepts plain and
+         * gzipped XML holding either the level's <d> node or a plist
+         * around its dict. A level without a name is rejected, as GD has
+         * nothing to show for it.
+         * @param path The file to read
+         * @param out Receives the level
+         * @returns gdshare::Result
+        */
+        inline Result read(const std::string & path, Loaded & out) {
+            out = Loaded();
+            Result failed { false, "Unable to import " + path };
+
+            io::MappedFile file;
+            if (!file.open(path).OK)
+                return failed;
+
+            auto data = file.data();
+            size_t size = file.size();
+            if (size >= 4 && std::memcmp(data, "PK\x03\x04", 4) == 0) {
+                out.zipped = true;
+                return failed;
+            }
+
+            std::string inflated;
+            if (size >= 2 && data[0] == 0x1f && data[1] == 0x8b) {
+                if (!codec::inflateInto(data, size, inflated))
+                    return failed;
+                data = reinterpret_cast<const uint8_t*>(inflated.data());
+                size = inflated.size();
+            }
+
+            out.doc = std::make_unique<rapidxml::xml_document<>>();
+            char* text = out.doc->allocate_string(nullptr, size + 1);
+            if (size) std::memcpy(text, data, size);
+            text[size] = '\0';
+
+            try {
+                out.doc->parse<rapidxml::parse_no_data_nodes>(text);
+            } catch (rapidxml::parse_error &) {
+                out.doc.reset();
+                return failed;
+            }
+
+            auto level = out.doc->first_node("d");
+            if (!level)
+                if (auto plist = out.doc->first_node("plist")) {
+                    // the level's dict is a <d> inside the save
+                    level = plist->first_node("dict");
+                    if (level) level->name("d", 1);
+                }
+            if (!level) {
+                out.doc.reset();
+                return failed;
+            }
+
+            auto name = view::node(level, keys::gd(Key::Name));
+            if (!name || !name->value_size()) {
+                out.doc.reset();
+                return { false, "The level in " + path + " has no name" };
+            }
+
+            out.level = level;
+            return { true, "" };
+        }
+        /**
+         * Export a level as a file. A drop-in for Level::exportTo that
+         * writes .gmd and .lvl files itself.
+         * @param level The level to export
+         * @param path See Level::exportTo
+         * @param type See Level::exportTo
+         * @returns gdshare::Result
+        */
+        inline Result exportTo(Level* level, const std::string & path = "", const std::string & type = filetypes::Default) {
+            if (!handles(type))
+                return level->exportTo(path, type);
+
+            std::string name (view::name(level));
+            auto file = target(name, path, type);
+            auto data = pack(level->xml, type);
+            if (data.empty())
+                return { false, "Unable to export \"" + name + "\"" };
+
+            auto res = write(file, data);
+            if (!res.OK) return res;
+            return { true, "Exported \"" + name + "\" to " + file };
+        }
+    }
+}
@@ -0,0 +1,1114 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <stdexcept>
+#include <functional>
+#include <algorithm>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <future>
+#include <charconv>
+#include "gdshare.hpp"
+#include "gdshare-codec.hpp"
+#include "gdshare-io.hpp"
+#include "gdshare-index.hpp"
+#include "gdshare-view.hpp"
+#include "gdshare-data.hpp"
+#include "gdshare-xml.hpp"
+#include "gdshare-pool.hpp"
+#include "gdshare-archive.hpp"
+#include "gdshare-levelfile.hpp"
+#include "gdshare-search.hpp"
+
+namespace gdshare {
+    /**
+     * Deep copy an XML node (names, values and attributes included)
+     * into another document's memory pool.
+     * @param doc The document to allocate the copy in
+     * @param src The node to copy
+     * @returns The copied node, not yet attached to anything
+    */
+    inline rapidxml::xml_node<>* cloneInto(rapidxml::xml_document<>* doc, const rapidxml::xml_node<>* src) {
+        auto copy = [doc](const char* str, size_t size) -> char* {
+            char* res = doc->allocate_string(nullptr, size + 1);
+            if (size) std::memcpy(res, str, size);
+            res[size] = '\0';
+            return res;
+        };
+
+        auto node = doc->allocate_node(
+            src->type(),
+            copy(src->name(), src->name_size()),
+            copy(src->value(), src->value_size()),
+            src->name_size(), src->value_size()
+        );
+
+        for (auto attr = src->first_attribute(); attr; attr = attr->next_attribute())
+            node->append_attribute(doc->allocate_attribute(
+                copy(attr->name(), attr->name_size()),
+                copy(attr->value(), attr->value_size()),
+                attr->name_size(), attr->value_size()
+            ));
+
+        for (auto child = src->first_node(); child; child = child->next_sibling())
+            node->append_node(cloneInto(doc, child));
+
+        return node;
+    }
+
+    /**
+     * Represents a CCLocalLevels.dat file, decoded with the single-pass
+     * codec::decodeX pipeline. The decoded XML lives in one buffer owned
+     * by this object, which rapidxml parses in place.
+     * Has the same interface as CCLocalLevels.
+    */
+    struct CCLocalLevelsX : public CCFile {
+        /**
+         * Get the path to vanilla GD's CCLocalLevels.dat file.
+         * @returns The path, or "" if it can't be figured out.
+        */
+        static std::string defaultPath() {
+            const char* appdata = std::getenv("LOCALAPPDATA");
+            if (!appdata) return "";
+            return std::string(appdata) + "/GeometryDash/CCLocalLevels.dat";
+        }
+
+        /**
+         * Create a new CCLocalLevelsX object
+         * and load vanilla GD's default CCLocalLevels.dat file for it.
+         * @param callback Optional function for monitoring the progress of
+         * the file's decoding. First parameter is string info, second is
+         * percentage decoded from 0-100.
+         * @throws std::runtime_error if unable to load the file.
+        */
+        CCLocalLevelsX(std::function<void (std::string, int)> callback = nullptr)
+            : CCLocalLevelsX(defaultPath(), callback) {}
+
+        /**
+         * Create a new CCLocalLevelsX object and load a specified CCLocalLevels.dat file for it.
+         * @param path The path to the CCLocalLevels.dat file.
+         * @param callback Optional function for monitoring the progress of
+         * the file's decoding. First parameter is string info, second is
+         * percentage decoded from 0-100.
+         * @throws std::runtime_error if unable to load the file.
+        */
+        CCLocalLevelsX(std::string path, std::function<void (std::string, int)> callback = nullptr) {
+            this->xml = nullptr;
+            auto res = this->initX(path, callback);
+            if (!res.OK)
+                throw std::runtime_error(res.info);
+        }
+
+        CCLocalLevelsX(const CCLocalLevelsX &) = delete;
+        CCLocalLevelsX & operator= (const CCLocalLevelsX &) = delete;
+
+        /**
+         * Destroy a CCLocalLevelsX object.
+        */
+        ~CCLocalLevelsX() override {
+            for (auto lvl : $levels)
+                delete lvl;
+            for (auto & lazy : $lazy)
+                delete lazy.level;
+            delete this->xml;
+            // the document is ours, don't let CCFile touch it
+            this->xml = nullptr;
+        }
+
+        /**
+         * Decode and parse a .dat file, replacing the current contents.
+         * @param path The path to a file compliant with GD CC files
+         * @param callback Optional progress callback, see CCFile::init
+         * @returns gdshare::Result
+        */
+        Result initX(std::string path, std::function<void (std::string, int)> callback = nullptr) {
+            io::MappedFile file;
+            auto res = file.open(path);
+            if (!res.OK) return res;
+
+            this->reset(path);
+            if (!io::DecodeCache::enabled())
+                return this->parseX(path, file.data(), file.size(), callback);
+
+            $identity = io::FileIdentity::of(path, file.data(), file.size());
+            $cacheable = true;
+
+            // metadata queries can be answered without decoding anything,
+            // the XML is only loaded once something needs it
+            if (LevelIndex::load(io::DecodeCache::entry($identity.path, ".idx"), $identity, $index)) {
+                $indexed = true;
+                if (callback) callback("Loaded index", 100);
+                return { true, "" };
+            }
+
+            return this->loadX(file, callback);
+        }
+
+        /**
+         * Get the amount of levels in the save. Only scans the level
+         * boundaries if the XML hasn't been fully parsed yet.
+        */
+        size_t levelCount() {
+            if ($parsed)
+                return this->loadLevels().size();
+            return this->scanLevels().size();
+        }
+
+        /**
+         * Get a level by its position in the save. Until something needs
+         * the whole XML tree, only this level's XML is parsed, into its own
+         * document. Such levels are read-only snapshots: edit levels from
+         * getLevels() if the changes should be saved.
+         * @param ix The level's position
+         * @returns The Level, or nullptr if out of range
+        */
+        Level* levelAt(size_t ix) {
+            if ($parsed) {
+                auto & lvls = this->loadLevels();
+                return ix < lvls.size() ? lvls[ix] : nullptr;
+            }
+
+            auto & spans = this->scanLevels();
+            if (ix >= spans.size())
+                return nullptr;
+
+            auto & lazy = $lazy[ix];
+            if (!lazy.level) {
+                lazy.doc = std::make_unique<rapidxml::xml_document<>>();
+                char* text = lazy.doc->allocate_string(nullptr, spans[ix].size + 1);
+                std::memcpy(text, $buffer.data() + spans[ix].offset, spans[ix].size);
+                text[spans[ix].size] = '\0';
+
+                try {
+                    lazy.doc->parse<rapidxml::parse_no_data_nodes>(text);
+                } catch (rapidxml::parse_error &) {
+                    lazy.doc.reset();
+                    return nullptr;
+                }
+                lazy.level = new Level(lazy.doc->first_node("d"));
+            }
+            return lazy.level;
+        }
+
+        /**
+         * Get the metadata index of the levels in the save. Built from the
+         * XML the first time, or read from the cache if GDSHARE_CACHE is set.
+         * Object counts are filled in lazily, see CCLocalLevelsX::objectCount.
+         * @returns The index
+        */
+        const LevelIndex & index() {
+            if (!$indexed) {
+                // until something needs the whole tree, parse each level's
+                // own XML into one scratch document that's reused
+                bool built = false;
+                if (!$parsed) {
+                    auto & spans = this->scanLevels();
+                    LevelIndex res;
+                    rapidxml::xml_document<> doc;
+                    std::string text;
+
+                    size_t ix = 0;
+                    for (; ix < spans.size(); ix++) {
+                        text.assign($buffer, spans[ix].offset, spans[ix].size);
+                        doc.clear();
+                        try {
+                            doc.parse<rapidxml::parse_no_data_nodes>(&text[0]);
+                        } catch (rapidxml::parse_error &) {
+                            break;
+                        }
+                        Level lvl (doc.first_node("d"));
+                        res.add(&lvl);
+                    }
+
+                    // a level that doesn't parse on its own is left to the
+                    // full parse to report
+                    if (ix == spans.size()) {
+                        $index = std::move(res);
+                        built = true;
+                    }
+                }
+                if (!built)
+                    $index = LevelIndex::build(this->loadLevels());
+
+                $indexed = true;
+                $indexDirty = true;
+            }
+            return $index;
+        }
+
+        /**
+         * Get the normalized level names for find, built from the index
+         * the first time.
+         * @returns The search buffer, see NameSearch
+        */
+        const NameSearch & nameSearch() {
+            if (!$searched) {
+                $search = NameSearch::build(this->index());
+                $searched = true;
+            }
+            return $search;
+        }
+
+        /**
+         * Get the trigram index of the level names for fuzzy search. Read
+         * from the cache if GDSHARE_CACHE is set and it matches the save,
+         * otherwise built from the index (and cached).
+         * @returns The trigram index, see TrigramIndex
+        */
+        const TrigramIndex & trigrams() {
+            if (!$trigrammed) {
+                auto file = $cacheable ? io::DecodeCache::entry($identity.path, ".tri") : std::filesystem::path();
+                if (file.empty() || !TrigramIndex::load(file, $identity, $trigrams) || $trigrams.size() != this->index().size()) {
+                    $trigrams = TrigramIndex::build(this->index());
+                    if (!file.empty())
+                        $trigrams.save(file, $identity);
+                }
+                $trigrammed = true;
+            }
+            return $trigrams;
+        }
+
+        /**
+         * Whether the index is available without building it, i.e. it was
+         * read from the cache or has been built already.
+        */
+        bool hasIndex() const {
+            return $indexed;
+        }
+
+        /**
+         * Get the object count of a level, computing it only if the index
+         * doesn't have it yet.
+         * @param ix The level's position in the save
+         * @returns The level's object count
+        */
+        int objectCount(size_t ix) {
+            this->index();
+            int count = $index.at(ix).objects;
+            if (count < 0) {
+                Level* lvl = this->levelAt(ix);
+                count = lvl ? $data.objectCount(lvl) : 0;
+                $index.setObjects(ix, count);
+                $indexDirty = true;
+            }
+            return count;
+        }
+
+        /**
+         * Get the object count of a level, decoding its data at most once.
+         * @param level A level from this save
+         * @returns The level's object count
+        */
+        int objectCount(const Level* level) {
+            return $data.objectCount(level);
+        }
+
+        /**
+         * Get the cache of decoded level data, e.g. to read a level's data
+         * without decoding it again, or to drop it under memory pressure.
+        */
+        LevelDataCache & dataCache() {
+            return $data;
+        }
+
+        /**
+         * Write the index to the cache if it has changed since it was
+         * loaded. Does nothing unless GDSHARE_CACHE is set.
+        */
+        void flushIndex() {
+            if ($indexed && $indexDirty && $cacheable)
+                $index.save(io::DecodeCache::entry($identity.path, ".idx"), $identity);
+            $indexDirty = false;
+        }
+
+        /**
+         * Save the CCLocalLevelsX along with any modifications you've made to it.
+         * The XML is printed straight into the compressor and the encoded
+         * output is handed to a writer thread as it's produced, so memory
+         * use stays at a few blocks no matter how big the save is, and
+         * compression overlaps with disk I/O. The save is written to a
+         * temporary file that replaces the old one only once it's complete,
+         * see io::AtomicWriter.
+         * Compression runs on multiple threads, see codec::GZipStream.
+         * @param encode Whether to re-encode the data or leave it as a plain-text file.
+         * @param callback Optional function for monitoring the progress of
+         * saving. First parameter is string info, second is percentage
+         * saved from 0-100.
+         * @param options Compression level and thread count
+         * @param durability How thoroughly to flush the save to disk
+         * @returns gdshare::Result
+        */
+        Result saveX(
+            bool encode = true,
+            std::function<void (std::string, int)> callback = nullptr,
+            codec::GZipOptions options = {},
+            io::Durability durability = io::Durability::Data
+        ) {
+            auto parsed = this->ensureParsed();
+            if (!parsed.OK) return parsed;
+
+            io::AtomicWriter file (this->path, durability);
+            if (!file.isOpen())
+                return { false, "Unable to open " + this->path + " for writing" };
+
+            auto toFile = [&file](const uint8_t* data, size_t size) -> bool {
+                return file.write(data, size);
+            };
+
+            if (callback) callback("Saving", 0);
+
+            bool ok;
+            if (encode) {
+                codec::EncodeStream encoder (toFile, codec::SaveKey);
+                codec::GZipStream gzip ([&encoder](const uint8_t* data, size_t size) -> bool {
+                    return encoder.write(data, size);
+                }, options);
+                xml::Writer writer ([&gzip](const uint8_t* data, size_t size) -> bool {
+                    return gzip.write(data, size);
+                });
+
+                ok = writer.print(this->xml) && writer.finish() && gzip.finish() && encoder.finish();
+            } else {
+                xml::Writer writer (toFile);
+                ok = writer.print(this->xml) && writer.finish();
+            }
+
+            if (!ok) {
+                file.discard();
+                return { false, "Unable to write " + this->path };
+            }
+
+            if (callback) callback("Flushing", 95);
+            auto res = file.commit();
+            if (!res.OK) return res;
+
+            if (callback) callback("Saved", 100);
+            return { true, "" };
+        }
+
+        /**
+         * Get a vector containing all the levels in the CCLocalLevelsX.
+         * @returns Vector of pointers to Level
+        */
+        std::vector<Level*> getLevels() {
+            return this->loadLevels();
+        }
+
+        /**
+         * Get a level by its name from the CCLocalLevelsX.
+         * @param name The level's name.
+         * @param casesensitive Whether to search for the level case-sensitive.
+         * @returns Level* if found, nullptr if not.
+        */
+        Level* getLevel(std::string_view name, bool casesensitive = false) {
+            auto same = [name, casesensitive](std::string_view str) -> bool {
+                return str.size() == name.size() && std::equal(str.begin(), str.end(), name.begin(),
+                    [casesensitive](unsigned char a, unsigned char b) {
+                        return casesensitive ? a == b : std::tolower(a) == std::tolower(b);
+                    });
+            };
+
+            if (!$parsed) {
+                // compare names straight from the text, only the match gets parsed
+                auto & spans = this->scanLevels();
+                for (size_t ix = 0; ix < spans.size(); ix++) {
+                    auto raw = this->scanName(spans[ix]);
+                    if (raw.find('&') == std::string_view::npos ? same(raw) : same(unescape(raw)))
+                        return this->levelAt(ix);
+                }
+                return nullptr;
+            }
+
+            for (auto lvl : this->loadLevels())
+                if (same(view::name(lvl)))
+                    return lvl;
+
+            return nullptr;
+        }
+
+        /**
+         * Export a level by its name. Basically an overload for CCLocalLevelsX::getLevel and Level::exportTo.
+         * @param name The level's name to export
+         * @param path The path to export to. See Level::exportTo for details.
+         * @param type The type of the export. See Level::exportTo for details.
+         * @returns gdshare::Result
+        */
+        Result exportLevel(std::string name, std::string path = "", std::string type = filetypes::Default) {
+            auto lvl = this->getLevel(name);
+            if (!lvl)
+                return { false, "Level \"" + name + "\" not found!" };
+            return this->exportLevel(lvl, path, type);
+        }
+
+        /**
+         * Export a level. Basically an overload for levelfile::exportTo.
+         * @param level The Level to export
+         * @param path The path to export to. See Level::exportTo for details.
+         * @param type The type of the export. See Level::exportTo for details.
+         * @returns gdshare::Result
+        */
+        Result exportLevel(Level* level, std::string path = "", std::string type = filetypes::Default) {
+            return levelfile::exportTo(level, path, type);
+        }
+
+        /**
+         * One level to export with CCLocalLevelsX::exportLevels.
+        */
+        struct ExportJob {
+            /**
+             * The level's name, not case-sensitive
+            */
+            std::string name;
+            /**
+             * See Level::exportTo
+            */
+            std::string path = "";
+            /**
+             * See Level::exportTo
+            */
+            std::string type = filetypes::Default;
+        };
+
+        /**
+         * Export many levels at once. .gmd and .lvl files are printed and
+         * compressed on a pool of worker threads, see levelfile::pack, and
+         * written to disk in order on the calling thread. Other types go
+         * through Level::exportTo, also on the calling thread, since the
+         * prebuilt library isn't known to be thread-safe. A job exporting
+         * the same level to the same file as an earlier one isn't run
+         * again and gets the earlier job's result.
+         * @param jobs The levels to export
+         * @param callback Called on the calling thread with each job's
+         * position and result, in order, as soon as that job is done
+         * @param threads Amount of workers, 0 for one per hardware thread
+         * @returns Amount of levels exported successfully
+        */
+        size_t exportLevels(
+            const std::vector<ExportJob> & jobs,
+            std::function<void (size_t, const Result &)> callback = nullptr,
+            unsigned int threads = 0
+        ) {
+            struct Task {
+                Level* level = nullptr;
+                std::string file;
+                // the earlier job this one repeats, or itself
+                size_t same = 0;
+                std::future<std::vector<uint8_t>> packed;
+            };
+
+            std::vector<Task> tasks (jobs.size());
+            std::vector<Result> results (jobs.size());
+            std::unordered_map<std::string, size_t> files;
+
+            size_t exported = 0;
+            ThreadPool pool (std::min<size_t>(threads ? threads : ThreadPool::defaultSize(), std::max<size_t>(jobs.size(), 1)));
+
+            // levels are looked up here, as that may parse them
+            for (size_t ix = 0; ix < jobs.size(); ix++) {
+                auto & job = jobs[ix];
+                auto & task = tasks[ix];
+                task.same = ix;
+                task.level = this->getLevel(job.name);
+                if (!task.level) continue;
+
+                task.file = levelfile::target(view::name(task.level), job.path, job.type);
+                auto [first, added] = files.emplace(task.file + '\n' + job.type, ix);
+                if (!added && tasks[first->second].level == task.level) {
+                    task.same = first->second;
+                    continue;
+                }
+                first->second = ix;
+
+                if (levelfile::handles(job.type))
+                    task.packed = pool.run([xml = task.level->xml, &type = job.type]() -> std::vector<uint8_t> {
+                        return levelfile::pack(xml, type);
+                    });
+            }
+
+            for (size_t ix = 0; ix < jobs.size(); ix++) {
+                auto & job = jobs[ix];
+                auto & task = tasks[ix];
+                auto & res = results[ix];
+
+                if (!task.level)
+                    res = { false, "Level \"" + job.name + "\" not found!" };
+                else if (task.same != ix)
+                    res = results[task.same];
+                else if (!task.packed.valid())
+                    res = task.level->exportTo(job.path, job.type);
+                else {
+                    auto data = task.packed.get();
+                    std::string name (view::name(task.level));
+                    if (data.empty())
+                        res = { false, "Unable to export \"" + name + "\"" };
+                    else if ((res = levelfile::write(task.file, data)).OK)
+                        res = { true, "Exported \"" + name + "\" to " + task.file };
+                }
+
+                if (res.OK) exported++;
+                if (callback) callback(ix, res);
+            }
+            return exported;
+        }
+
+        /**
+         * Back up levels into a single archive, see LevelArchive. Levels
+         * are compressed in parallel and written as they finish.
+         * @param path The archive to write
+         * @param filter Only back up levels whose name contains this, not
+         * case-sensitive; "" for all levels
+         * @param options Compression level and thread count
+         * @returns gdshare::Result
+        */
+        Result exportAll(const std::string & path, std::string filter = "", codec::GZipOptions options = {}) {
+            std::transform(filter.begin(), filter.end(), filter.begin(),
+                [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+            LevelArchive::Writer archive (path, options);
+            if (!archive.isOpen())
+                return { false, "Unable to create " + path };
+
+            size_t count = this->levelCount();
+            for (size_t ix = 0; ix < count; ix++) {
+                Level* lvl = this->levelAt(ix);
+                if (!lvl || !view::containsFolded(view::name(lvl), filter))
+                    continue;
+                if (!archive.add(lvl))
+                    break;
+            }
+
+            auto res = archive.finish();
+            if (!res.OK) return res;
+            return { true, "Backed up " + std::to_string(archive.entries().size()) + " levels to " + path };
+        }
+
+        /**
+         * Import a Level. The level's XML is copied into this save as
+         * k_0, so the passed Level can be destroyed afterwards.
+         * @param level The Level to import
+         * @returns gdshare::Result
+        */
+        Result importLevel(Level* level) {
+            return this->importLevelX(level) ?
+                Result { true, "Level \"" + level->name() + "\" imported!" } :
+                Result { false, "Save has no level list" };
+        }
+
+        /**
+         * Import many level files at once. All files are read, decoded and
+         * checked in parallel first, see levelfile::read; .gmd2 files are
+         * then loaded one after another with Level::load, since the
+         * prebuilt library isn't known to be thread-safe. The levels that
+         * loaded are inserted into the save in one pass, in the same order
+         * importing them one by one would give. Levels without a name are
+         * rejected.
+         * @param paths The files to import
+         * @param threads Amount of workers, 0 for one per hardware thread
+         * @returns A result for every file, in order
+        */
+        std::vector<Result> importLevels(const std::vector<std::string> & paths, unsigned int threads = 0) {
+            std::vector<levelfile::Loaded> files (paths.size());
+            std::vector<Result> read (paths.size());
+            {
+                ThreadPool pool (std::min<size_t>(threads ? threads : ThreadPool::defaultSize(), std::max<size_t>(paths.size(), 1)));
+                std::vector<std::future<Result>> jobs;
+                for (size_t ix = 0; ix < paths.size(); ix++)
+                    jobs.push_back(pool.run([&path = paths[ix], &file = files[ix]]() -> Result {
+                        return levelfile::read(path, file);
+                    }));
+                for (size_t ix = 0; ix < paths.size(); ix++)
+                    read[ix] = jobs[ix].get();
+            }
+
+            std::vector<Level*> loaded (paths.size(), nullptr);
+            for (size_t ix = 0; ix < paths.size(); ix++) {
+                if (read[ix].OK)
+                    loaded[ix] = new Level(files[ix].level);
+                else if (files[ix].zipped) {
+                    Level* lvl = Level::load(paths[ix]);
+                    if (lvl && (!lvl->xml || view::name(lvl).empty())) {
+                        if (lvl->xml)
+                            read[ix] = { false, "The level in " + paths[ix] + " has no name" };
+                        delete lvl;
+                        lvl = nullptr;
+                    }
+                    loaded[ix] = lvl;
+                }
+            }
+
+            std::vector<Level*> valid;
+            for (auto lvl : loaded)
+                if (lvl) valid.push_back(lvl);
+
+            auto parsed = this->ensureParsed();
+            std::vector<Level*> inserted;
+            if (parsed.OK && !valid.empty())
+                inserted = this->importLevelsX(valid);
+
+            std::vector<Result> res;
+            size_t next = 0;
+            for (size_t ix = 0; ix < paths.size(); ix++) {
+                if (!loaded[ix])
+                    res.push_back(read[ix]);
+                else if (inserted.empty())
+                    res.push_back({ false, parsed.OK ? "Save has no level list" : parsed.info });
+                else
+                    res.push_back({ true, "Level \"" + inserted[next++]->name() + "\" imported!" });
+                delete loaded[ix];
+            }
+            return res;
+        }
+
+        /**
+         * Import a Level from a file, and return the imported Level*.
+         * @param path The file to import
+         * @returns The level that was imported, or nullptr if importing failed.
+        */
+        Level* importLevelC(const std::string & path) {
+            Level* src = Level::load(path);
+            if (!src) return nullptr;
+
+            Level* res = this->importLevelX(src);
+            delete src;
+            return res;
+        }
+
+        /**
+         * Import a Level from a file.
+         * @param path The file to import
+         * @returns gdshare::Result
+        */
+        Result importLevel(const std::string & path) {
+            Level* lvl = this->importLevelC(path);
+            if (!lvl)
+                return { false, "Unable to import " + path };
+            return { true, "Level \"" + lvl->name() + "\" imported!" };
+        }
+
+        protected:
+            /**
+             * Parse the whole XML and wrap every level, the first time.
+             * @returns The levels, see getLevels
+            */
+            const std::vector<Level*> & loadLevels() {
+                if ($levelsLoaded || !this->ensureParsed().OK)
+                    return $levels;
+
+                auto root = this->levelsNode();
+                if (root)
+                    for (auto k = root->first_node("k"); k; k = k->next_sibling("k")) {
+                        auto d = k->next_sibling();
+                        if (!d || std::strncmp(k->value(), "k_", 2) != 0)
+                            continue;
+                        $levels.push_back(new Level(d));
+                    }
+
+                $levelsLoaded = true;
+                return $levels;
+            }
+
+            /**
+             * Forget the current contents before loading a file.
+            */
+            void reset(const std::string & path) {
+                for (auto lvl : $levels)
+                    delete lvl;
+                $levels.clear();
+                $data.clear();
+                $levelsLoaded = false;
+                $parsed = false;
+                $indexed = false;
+                $indexDirty = false;
+                $searched = false;
+                $trigrammed = false;
+                $cacheable = false;
+                $decoded = false;
+                this->dropLazy();
+                this->path = path;
+            }
+
+            /**
+             * A level's <d>...</d> element in the decoded text.
+            */
+            struct Span {
+                size_t offset;
+                size_t size;
+            };
+
+            /**
+             * A level parsed on its own by levelAt.
+            */
+            struct LazyLevel {
+                Level* level = nullptr;
+                std::unique_ptr<rapidxml::xml_document<>> doc;
+            };
+
+            void dropLazy() {
+                for (auto & lazy : $lazy) {
+                    $data.invalidate(lazy.level);
+                    delete lazy.level;
+                }
+                $lazy.clear();
+                $spans.clear();
+                $scanned = false;
+            }
+
+            /**
+             * Make sure the decoded text is in $buffer. Only does work
+             * if the index was read from the cache.
+             * @returns gdshare::Result
+            */
+            Result ensureDecoded() {
+                if ($decoded)
+                    return { true, "" };
+
+                io::MappedFile file;
+                auto res = file.open(this->path);
+                if (!res.OK) return res;
+                return this->loadX(file, nullptr);
+            }
+
+            /**
+             * Make sure the whole XML tree is parsed.
+             * @returns gdshare::Result
+            */
+            Result ensureParsed() {
+                if ($parsed)
+                    return { true, "" };
+
+                auto res = this->ensureDecoded();
+                if (!res.OK) return res;
+
+                if (!this->xml)
+                    this->xml = new rapidxml::xml_document<>();
+                this->xml->clear();
+
+                try {
+                    this->xml->parse<rapidxml::parse_no_data_nodes>(&$buffer[0]);
+                } catch (rapidxml::parse_error & e) {
+                    return { false, std::string("Unable to parse save: ") + e.what() };
+                }
+
+                // parsing in place mangles the text, so the spans are gone
+                $spans.clear();
+                $parsed = true;
+                return { true, "" };
+            }
+
+            /**
+             * Find the boundaries of every level in the decoded text without
+             * building any XML nodes.
+             * @returns Spans in save order, empty if the text can't be read
+            */
+            const std::vector<Span> & scanLevels() {
+                if ($scanned || $parsed || !this->ensureDecoded().OK)
+                    return $spans;
+                $scanned = true;
+
+                const std::string & text = $buffer;
+                auto skipSpace = [&text](size_t pos) {
+                    while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos])))
+                        pos++;
+                    return pos;
+                };
+                auto startsWith = [&text](size_t pos, const char* str) {
+                    return text.compare(pos, std::strlen(str), str) == 0;
+                };
+
+                size_t pos = text.find("<k>LLM_01</k>");
+                if (pos == std::string::npos) return $spans;
+                pos = skipSpace(pos + 13);
+                if (!startsWith(pos, "<d>")) return $spans;
+                pos += 3;
+
+                for (;;) {
+                    pos = skipSpace(pos);
+                    if (pos >= text.size() || !startsWith(pos, "<k>"))
+                        break;
+
+                    size_t keyEnd = text.find("</k>", pos);
+                    if (keyEnd == std::string::npos) break;
+                    bool isLevel = startsWith(pos + 3, "k_");
+
+                    size_t start = skipSpace(keyEnd + 4);
+                    size_t end = this->elementEnd(start);
+                    if (end == std::string::npos) break;
+
+                    if (isLevel && startsWith(start, "<d"))
+                        $spans.push_back({ start, end - start });
+                    pos = end;
+                }
+
+                $lazy.resize($spans.size());
+                return $spans;
+            }
+
+            /**
+             * Find the end of the element starting at pos.
+             * @returns Position right after the element, npos if unterminated
+            */
+            size_t elementEnd(size_t pos) const {
+                const std::string & text = $buffer;
+                size_t close = text.find('>', pos);
+                if (close == std::string::npos || text[pos] != '<') return std::string::npos;
+                if (text[close - 1] == '/') return close + 1;
+
+                size_t nameEnd = text.find_first_of(" />", pos + 1);
+                std::string_view name (&text[pos + 1], nameEnd - pos - 1);
+
+                // values never contain a raw '<', so only nested tags of the
+                // same name matter
+                int depth = 1;
+                for (size_t at = close + 1; depth; ) {
+                    at = text.find('<', at);
+                    if (at == std::string::npos) return std::string::npos;
+
+                    size_t end = text.find('>', at);
+                    if (end == std::string::npos) return std::string::npos;
+
+                    bool closing = text[at + 1] == '/';
+                    size_t nameAt = at + (closing ? 2 : 1);
+                    size_t tagEnd = text.find_first_of(" />", nameAt);
+                    if (tagEnd - nameAt == name.size() && text.compare(nameAt, name.size(), name) == 0) {
+                        if (closing) depth--;
+                        else if (text[end - 1] != '/') depth++;
+                    }
+                    at = end + 1;
+                    if (!depth) return at;
+                }
+                return std::string::npos;
+            }
+
+            /**
+             * Get a level's name straight from its text, with XML entities
+             * still escaped.
+            */
+            std::string_view scanName(const Span & span) const {
+                const std::string & text = $buffer;
+                size_t end = span.offset + span.size;
+                auto skipSpace = [&text](size_t pos) {
+                    while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos])))
+                        pos++;
+                    return pos;
+                };
+
+                // walk the level dict's own key/value pairs, skipping over
+                // nested dicts that may hold a k2 of their own
+                size_t pos = text.find('>', span.offset);
+                if (pos == std::string::npos || pos >= end || text[pos - 1] == '/') return "";
+                auto name = keys::gd(Key::Name);
+                for (pos++;;) {
+                    pos = skipSpace(pos);
+                    if (pos >= end || text.compare(pos, 3, "<k>") != 0)
+                        return "";
+
+                    size_t keyEnd = text.find("</k>", pos);
+                    if (keyEnd == std::string::npos || keyEnd >= end) return "";
+                    std::string_view key (&text[pos + 3], keyEnd - pos - 3);
+
+                    size_t value = skipSpace(keyEnd + 4);
+                    size_t valueEnd = this->elementEnd(value);
+                    if (valueEnd == std::string::npos || valueEnd > end) return "";
+
+                    if (key == name) {
+                        if (text.compare(value, 3, "<s>") != 0 || valueEnd - value < 7)
+                            return "";
+                        return std::string_view(&text[value + 3], valueEnd - value - 7);
+                    }
+                    pos = valueEnd;
+                }
+            }
+
+            /**
+             * Expand the XML entities rapidxml would expand when parsing.
+            */
+            static std::string unescape(std::string_view str) {
+                static const std::pair<const char*, char> entities[] = {
+                    { "&amp;", '&' }, { "&lt;", '<' }, { "&gt;", '>' }, { "&quot;", '"' }, { "&apos;", '\'' }
+                };
+
+                std::string res;
+                res.reserve(str.size());
+                for (size_t i = 0; i < str.size(); i++) {
+                    if (str[i] == '&') {
+                        bool found = false;
+                        for (auto & [name, c] : entities)
+                            if (str.compare(i, std::strlen(name), name) == 0) {
+                                res += c;
+                                i += std::strlen(name) - 1;
+                                found = true;
+                                break;
+                            }
+                        if (found) continue;
+                    }
+                    res += str[i];
+                }
+                return res;
+            }
+
+            /**
+             * Load the decoded XML from the cache, or decode the file and
+             * cache the result, then parse it.
+             * @returns gdshare::Result
+            */
+            Result loadX(const io::MappedFile & file, std::function<void (std::string, int)> callback) {
+                if (io::DecodeCache::load($identity, $buffer)) {
+                    if (callback) callback("Loaded from cache", 100);
+                    return this->adoptBuffer(this->path);
+                }
+
+                auto res = codec::decodeX(file.data(), file.size(), $buffer, callback);
+                if (!res.OK) return res;
+
+                // parsing happens in place, so cache the text before it
+                io::DecodeCache::store($identity, $buffer);
+                return this->adoptBuffer(this->path);
+            }
+
+            /**
+             * Decode raw file contents and parse them as this save.
+             * @returns gdshare::Result
+            */
+            Result parseX(const std::string & path, const uint8_t* data, size_t size, std::function<void (std::string, int)> callback) {
+                auto res = codec::decodeX(data, size, $buffer, callback);
+                if (!res.OK) return res;
+
+                return this->adoptBuffer(path);
+            }
+
+            /**
+             * Use the decoded XML in $buffer as this save. Nothing is parsed
+             * until it's needed, see ensureParsed and scanLevels.
+             * @returns gdshare::Result
+            */
+            Result adoptBuffer(const std::string & path) {
+                for (auto lvl : $levels)
+                    delete lvl;
+                $levels.clear();
+                $levelsLoaded = false;
+                this->dropLazy();
+
+                this->path = path;
+                $decoded = true;
+                $parsed = false;
+                return { true, "" };
+            }
+
+            /**
+             * Get the <d> node that holds the k_N level entries.
+            */
+            rapidxml::xml_node<>* levelsNode() {
+                if (!this->ensureParsed().OK)
+                    return nullptr;
+
+                auto plist = this->xml->first_node("plist");
+                if (!plist) return nullptr;
+                auto dict = plist->first_node("dict");
+                if (!dict) return nullptr;
+
+                for (auto k = dict->first_node("k"); k; k = k->next_sibling("k"))
+                    if (std::strcmp(k->value(), "LLM_01") == 0)
+                        return k->next_sibling("d");
+
+                return nullptr;
+            }
+
+            /**
+             * Insert a copy of a level's XML as k_0, shifting every
+             * other level's key up by one.
+             * @returns The Level in this save, or nullptr on failure
+            */
+            Level* importLevelX(Level* level) {
+                auto res = this->importLevelsX({ level });
+                return res.empty() ? nullptr : res.front();
+            }
+
+            /**
+             * Insert copies of levels at the top of the save in one pass.
+             * The result matches importing them one by one: the last level
+             * ends up as k_0.
+             * @param levels The levels to insert
+             * @returns The inserted levels in the same order, or an empty
+             * vector if the save has no level list
+            */
+            std::vector<Level*> importLevelsX(const std::vector<Level*> & levels) {
+                auto root = this->levelsNode();
+                if (!root) return {};
+
+                this->loadLevels();
+
+                // shift the existing keys once, by the whole batch
+                size_t count = levels.size();
+                rapidxml::xml_node<>* first = nullptr;
+                char num[24];
+                for (auto k = root->first_node("k"); k; k = k->next_sibling("k")) {
+                    if (std::strncmp(k->value(), "k_", 2) != 0)
+                        continue;
+                    if (!first) first = k;
+
+                    long long ix = std::atoll(k->value() + 2) + static_cast<long long>(count);
+                    auto end = std::to_chars(num, num + sizeof num, ix).ptr;
+                    size_t len = static_cast<size_t>(end - num);
+                    char* val = this->xml->allocate_string(nullptr, len + 3);
+                    val[0] = 'k';
+                    val[1] = '_';
+                    std::memcpy(val + 2, num, len);
+                    val[len + 2] = '\0';
+                    k->value(val, len + 2);
+                }
+
+                std::vector<Level*> res (count);
+                for (size_t ix = 0; ix < count; ix++) {
+                    // the last level goes first, as if imported last
+                    size_t pos = count - 1 - ix;
+                    auto end = std::to_chars(num, num + sizeof num, ix).ptr;
+                    size_t len = static_cast<size_t>(end - num);
+                    char* name = this->xml->allocate_string(nullptr, len + 3);
+                    name[0] = 'k';
+                    name[1] = '_';
+                    std::memcpy(name + 2, num, len);
+                    name[len + 2] = '\0';
+
+                    auto key = this->xml->allocate_node(rapidxml::node_element, "k", name, 0, len + 2);
+                    auto data = cloneInto(this->xml, levels[pos]->xml);
+                    root->insert_node(first, key);
+                    root->insert_node(first, data);
+                    res[pos] = new Level(data);
+                }
+
+                $levels.insert($levels.begin(), res.rbegin(), res.rend());
+
+                // the index and the cache key describe the file as it was
+                $indexed = false;
+                $searched = false;
+                $trigrammed = false;
+                $cacheable = false;
+                return res;
+            }
+
+            std::string $buffer;
+            std::vector<Level*> $levels;
+            bool $levelsLoaded = false;
+            bool $decoded = false;
+            bool $parsed = false;
+            std::vector<Span> $spans;
+            std::vector<LazyLevel> $lazy;
+            LevelDataCache $data;
+            bool $scanned = false;
+            io::FileIdentity $identity;
+            bool $cacheable = false;
+            LevelIndex $index;
+            bool $indexed = false;
+            bool $indexDirty = false;
+            NameSearch $search;
+            bool $searched = false;
+            TrigramIndex $trigrams;
+            bool $trigrammed = false;
+    };
+}
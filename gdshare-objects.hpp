@@ -0,0 +1,504 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <span>
+#include <cctype>
+#include <charconv>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace gdshare {
+    /**
+     * A level's object string parsed into columns. The common keys get a
+     * column each (id, x, y, rotation, groups), everything else goes into
+     * a sparse table of extra key-value pairs. All text, i.e. the level
+     * header, extra values and the original object string, lives in one
+     * arena, so parsing a level costs a handful of allocations no matter
+     * how many objects it has.
+     *
+     * Objects are read and edited by position. Edits mark the object as
+     * touched, which the serializer uses to copy untouched objects
+     * verbatim.
+    */
+    struct ObjectTable {
+        /**
+         * Object keys that have a column.
+        */
+        enum Column : int {
+            Id = 1,
+            X = 2,
+            Y = 3,
+            Rotation = 6,
+            Groups = 57
+        };
+
+        /**
+         * Bits of ObjectTable::columns, set for the columns an object has.
+        */
+        enum Has : uint8_t {
+            HasId       = 1 << 0,
+            HasX        = 1 << 1,
+            HasY        = 1 << 2,
+            HasRotation = 1 << 3,
+            HasGroups   = 1 << 4
+        };
+
+        /**
+         * Extra::key of a pair kept verbatim.
+        */
+        static constexpr int32_t RawPair = -1;
+
+        /**
+         * A string in the arena.
+        */
+        struct StrRef {
+            uint32_t offset;
+            uint32_t size;
+        };
+
+        /**
+         * A key that has no column. Pairs whose key isn't a number are kept
+         * whole with key RawPair, value then holding "key,value", and so
+         * is a trailing key without a value, value holding just "key".
+        */
+        struct Extra {
+            int32_t key;
+            StrRef value;
+        };
+
+        /**
+         * Parse a decoded object string, e.g. from Level::data.
+         * @param data The object string
+         * @returns The parsed table
+        */
+        static ObjectTable parse(std::string_view data) {
+            ObjectTable res;
+            res.$arena.reserve(data.size());
+            res.$arena.assign(data);
+            res.$original = data.size();
+
+            std::string_view text (res.$arena);
+            size_t pos = 0;
+
+            // the first segment holds the level's settings (kA2,0,kS38,...)
+            size_t first = text.find(';');
+            std::string_view head = text.substr(0, first);
+            if (!head.empty() && !std::isdigit(static_cast<unsigned char>(head[0]))) {
+                res.$header = { 0, static_cast<uint32_t>(head.size()) };
+                pos = first == std::string_view::npos ? text.size() : first + 1;
+            }
+
+            size_t estimate = static_cast<size_t>(std::count(text.begin() + pos, text.end(), ';'));
+            res.reserve(estimate);
+
+            while (pos < text.size()) {
+                size_t end = text.find(';', pos);
+                if (end == std::string_view::npos) end = text.size();
+                if (end > pos)
+                    res.parseObject(text, pos, end);
+                pos = end + 1;
+            }
+
+            return res;
+        }
+
+        /**
+         * Get the amount of objects.
+        */
+        size_t size() const {
+            return $id.size();
+        }
+
+        /**
+         * Get the level header, i.e. the part before the first object.
+        */
+        std::string_view header() const {
+            return this->str($header);
+        }
+
+        /**
+         * Get a string from the arena.
+        */
+        std::string_view str(StrRef ref) const {
+            return std::string_view($arena.data() + ref.offset, ref.size);
+        }
+
+        // columns, for bulk reads
+
+        const std::vector<int32_t> & ids() const { return $id; }
+        const std::vector<double> & xs() const { return $x; }
+        const std::vector<double> & ys() const { return $y; }
+        const std::vector<double> & rotations() const { return $rotation; }
+        const std::vector<uint8_t> & columns() const { return $has; }
+
+        // single values
+
+        int32_t id(size_t ix) const { return $id[ix]; }
+        double x(size_t ix) const { return $x[ix]; }
+        double y(size_t ix) const { return $y[ix]; }
+        double rotation(size_t ix) const { return $rotation[ix]; }
+
+        /**
+         * Get the groups of an object.
+        */
+        std::span<const int32_t> groups(size_t ix) const {
+            return std::span<const int32_t>($groupIds.data() + $groupStart[ix], $groupStart[ix + 1] - $groupStart[ix]);
+        }
+
+        /**
+         * Get the keys of an object that have no column.
+        */
+        std::span<const Extra> extras(size_t ix) const {
+            return std::span<const Extra>($extras.data() + $extraStart[ix], $extraStart[ix + 1] - $extraStart[ix]);
+        }
+
+        /**
+         * Get the value of a key that has no column.
+         * @returns The value, or "" if the object doesn't have the key
+        */
+        std::string_view extra(size_t ix, int32_t key) const {
+            for (auto & e : this->extras(ix))
+                if (e.key == key)
+                    return this->str(e.value);
+            return "";
+        }
+
+        // edits; each marks the object as touched
+
+        void id(size_t ix, int32_t value) { $id[ix] = value; this->touch(ix, HasId); }
+        void x(size_t ix, double value) { $x[ix] = value; this->touch(ix, HasX); }
+        void y(size_t ix, double value) { $y[ix] = value; this->touch(ix, HasY); }
+        void rotation(size_t ix, double value) { $rotation[ix] = value; this->touch(ix, HasRotation); }
+
+        /**
+         * Replace the groups of an object.
+        */
+        void groups(size_t ix, std::span<const int32_t> groups) {
+            // groups may point into $groupIds
+            std::vector<int32_t> copy;
+            if (groups.data() >= $groupIds.data() && groups.data() < $groupIds.data() + $groupIds.size()) {
+                copy.assign(groups.begin(), groups.end());
+                groups = copy;
+            }
+
+            auto from = $groupIds.begin() + $groupStart[ix], to = $groupIds.begin() + $groupStart[ix + 1];
+            ptrdiff_t diff = static_cast<ptrdiff_t>(groups.size()) - (to - from);
+            size_t at = $groupStart[ix];
+
+            $groupIds.erase(from, to);
+            $groupIds.insert($groupIds.begin() + at, groups.begin(), groups.end());
+            for (size_t i = ix + 1; i < $groupStart.size(); i++)
+                $groupStart[i] += static_cast<uint32_t>(diff);
+
+            this->touch(ix, HasGroups);
+            if (groups.empty()) $has[ix] &= ~HasGroups;
+        }
+
+        /**
+         * Set the value of a key that has no column. The value is copied
+         * into the arena.
+        */
+        void extra(size_t ix, int32_t key, std::string_view value) {
+            StrRef ref = this->intern(value);
+            for (size_t i = $extraStart[ix]; i < $extraStart[ix + 1]; i++)
+                if ($extras[i].key == key) {
+                    $extras[i].value = ref;
+                    this->touch(ix, 0);
+                    return;
+                }
+
+            $extras.insert($extras.begin() + $extraStart[ix + 1], Extra { key, ref });
+            for (size_t i = ix + 1; i < $extraStart.size(); i++)
+                $extraStart[i]++;
+            this->touch(ix, 0);
+        }
+
+        /**
+         * Add an object at the end.
+         * @returns The new object's position
+        */
+        size_t add(int32_t id, double x, double y) {
+            this->push(HasId | HasX | HasY, { 0, 0 });
+            $id.back() = id;
+            $x.back() = x;
+            $y.back() = y;
+            $touched.back() = true;
+            $edited = true;
+            return this->size() - 1;
+        }
+
+        /**
+         * Whether an object was edited or added since parsing.
+        */
+        bool touched(size_t ix) const {
+            return $touched[ix];
+        }
+
+        /**
+         * Get the original text of an object, without the trailing ';'.
+         * Empty for added objects.
+        */
+        std::string_view source(size_t ix) const {
+            return this->str($source[ix]);
+        }
+
+        /**
+         * Get an upper bound for the size of ObjectTable::serialize's output.
+        */
+        size_t serializedBound() const {
+            if (!$edited)
+                return $original;
+
+            // longest to_chars output for an int32 / a double
+            constexpr size_t Int = 11, Real = 24;
+
+            size_t res = $header.size + 1;
+            for (size_t ix = 0; ix < this->size(); ix++) {
+                if (!$touched[ix]) {
+                    res += $source[ix].size + 1;
+                    continue;
+                }
+                res += 4 * (4 + Real) + 4 + (Int + 1) * this->groups(ix).size() + 1;
+                for (auto & e : this->extras(ix))
+                    res += Int + 2 + e.value.size;
+            }
+            return res;
+        }
+
+        /**
+         * Write the objects back into GD's object string format. Untouched
+         * objects are copied from the original text byte for byte, edited
+         * and added ones are written with std::to_chars.
+         * @param out Output buffer of at least serializedBound() bytes
+         * @returns Amount of bytes written
+        */
+        size_t serialize(char* out) const {
+            if (!$edited) {
+                std::memcpy(out, $arena.data(), $original);
+                return $original;
+            }
+
+            char* at = out;
+            auto raw = [&at](std::string_view str) -> void {
+                std::memcpy(at, str.data(), str.size());
+                at += str.size();
+            };
+            auto num = [&at](auto value) -> void {
+                at = std::to_chars(at, at + 32, value).ptr;
+            };
+            auto key = [&at, &num](int32_t key, bool first) -> void {
+                if (!first) *at++ = ',';
+                num(key);
+                *at++ = ',';
+            };
+
+            if ($header.size) {
+                raw(this->header());
+                *at++ = ';';
+            }
+
+            for (size_t ix = 0; ix < this->size(); ix++) {
+                if (!$touched[ix]) {
+                    raw(this->source(ix));
+                    *at++ = ';';
+                    continue;
+                }
+
+                bool first = true;
+                uint8_t has = $has[ix];
+                if (has & HasId) { key(Id, first); num($id[ix]); first = false; }
+                if (has & HasX) { key(X, first); num($x[ix]); first = false; }
+                if (has & HasY) { key(Y, first); num($y[ix]); first = false; }
+                if (has & HasRotation) { key(Rotation, first); num($rotation[ix]); first = false; }
+                if (has & HasGroups) {
+                    key(Groups, first);
+                    first = false;
+                    bool dot = false;
+                    for (int32_t group : this->groups(ix)) {
+                        if (dot) *at++ = '.';
+                        num(group);
+                        dot = true;
+                    }
+                }
+                for (auto & e : this->extras(ix)) {
+                    if (e.key == RawPair) {
+                        if (!first) *at++ = ',';
+                    } else
+                        key(e.key, first);
+                    raw(this->str(e.value));
+                    first = false;
+                }
+                *at++ = ';';
+            }
+
+            return at - out;
+        }
+
+        /**
+         * Write the objects back into GD's object string format.
+         * @returns The object string, ready for Level::data
+        */
+        std::string serialize() const {
+            std::string res (this->serializedBound(), '\0');
+            res.resize(this->serialize(&res[0]));
+            return res;
+        }
+
+        /**
+         * Reserve room for a number of objects.
+        */
+        void reserve(size_t count) {
+            $id.reserve(count);
+            $x.reserve(count);
+            $y.reserve(count);
+            $rotation.reserve(count);
+            $has.reserve(count);
+            $touched.reserve(count);
+            $source.reserve(count);
+            $groupStart.reserve(count + 1);
+            $extraStart.reserve(count + 1);
+        }
+
+        protected:
+            void push(uint8_t has, StrRef source) {
+                $id.push_back(0);
+                $x.push_back(0);
+                $y.push_back(0);
+                $rotation.push_back(0);
+                $has.push_back(has);
+                $touched.push_back(false);
+                $source.push_back(source);
+                $groupStart.push_back($groupStart.back());
+                $extraStart.push_back($extraStart.back());
+            }
+
+            void touch(size_t ix, uint8_t has) {
+                $has[ix] |= has;
+                $touched[ix] = true;
+                $edited = true;
+            }
+
+            StrRef intern(std::string_view str) {
+                StrRef ref { static_cast<uint32_t>($arena.size()), static_cast<uint32_t>(str.size()) };
+                $arena.append(str);
+                return ref;
+            }
+
+            /**
+             * Get the reference of a view into the arena.
+            */
+            StrRef ref(std::string_view str) const {
+                return { static_cast<uint32_t>(str.data() - $arena.data()), static_cast<uint32_t>(str.size()) };
+            }
+
+            template<class T>
+            static bool number(std::string_view str, T & out) {
+                auto res = std::from_chars(str.data(), str.data() + str.size(), out);
+                return res.ec == std::errc() && res.ptr == str.data() + str.size();
+            }
+
+            /**
+             * Parse one "key,value,key,value" object in [pos, end).
+            */
+            void parseObject(std::string_view text, size_t pos, size_t end) {
+                this->push(0, { static_cast<uint32_t>(pos), static_cast<uint32_t>(end - pos) });
+                size_t ix = this->size() - 1;
+
+                while (pos < end) {
+                    size_t comma = text.find(',', pos);
+                    if (comma == std::string_view::npos || comma > end) comma = end;
+                    std::string_view key = text.substr(pos, comma - pos);
+
+                    pos = comma + 1;
+                    if (pos > end) {
+                        // a key without a value is kept as it was
+                        $extras.push_back({ RawPair, this->ref(key) });
+                        $extraStart.back()++;
+                        break;
+                    }
+
+                    size_t next = text.find(',', pos);
+                    if (next == std::string_view::npos || next > end) next = end;
+                    std::string_view value = text.substr(pos, next - pos);
+                    pos = next + 1;
+
+                    int32_t k = 0;
+                    if (!number(key, k) || k < 0) {
+                        std::string_view pair = text.substr(key.data() - text.data(), value.data() + value.size() - key.data());
+                        $extras.push_back({ RawPair, this->ref(pair) });
+                        $extraStart.back()++;
+                    } else if (!this->parseColumn(ix, k, value)) {
+                        $extras.push_back({ k, this->ref(value) });
+                        $extraStart.back()++;
+                    }
+                }
+            }
+
+            bool parseColumn(size_t ix, int32_t key, std::string_view value) {
+                switch (key) {
+                    case Id:
+                        if (!number(value, $id[ix])) return false;
+                        $has[ix] |= HasId;
+                        return true;
+
+                    case X:
+                        if (!number(value, $x[ix])) return false;
+                        $has[ix] |= HasX;
+                        return true;
+
+                    case Y:
+                        if (!number(value, $y[ix])) return false;
+                        $has[ix] |= HasY;
+                        return true;
+
+                    case Rotation:
+                        if (!number(value, $rotation[ix])) return false;
+                        $has[ix] |= HasRotation;
+                        return true;
+
+                    case Groups: {
+                        size_t start = $groupIds.size();
+                        for (size_t at = 0; at < value.size(); ) {
+                            size_t dot = value.find('.', at);
+                            if (dot == std::string_view::npos) dot = value.size();
+                            int32_t group;
+                            if (!number(value.substr(at, dot - at), group)) {
+                                $groupIds.resize(start);
+                                return false;
+                            }
+                            $groupIds.push_back(group);
+                            at = dot + 1;
+                        }
+                        $groupStart.back() = static_cast<uint32_t>($groupIds.size());
+                        $has[ix] |= HasGroups;
+                        return true;
+                    }
+
+                    default:
+                        return false;
+                }
+            }
+
+            std::string $arena;
+            size_t $original = 0;
+            bool $edited = false;
+            StrRef $header { 0, 0 };
+
+            std::vector<int32_t> $id;
+            std::vector<double> $x;
+            std::vector<double> $y;
+            std::vector<double> $rotation;
+            std::vector<uint8_t> $has;
+            std::vector<bool> $touched;
+            std::vector<StrRef> $source;
+
+            // groups and extras of object i are [start[i], start[i + 1])
+            std::vector<int32_t> $groupIds;
+            std::vector<uint32_t> $groupStart { 0 };
+            std::vector<Extra> $extras;
+            std::vector<uint32_t> $extraStart { 0 };
+    };
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+
+namespace gdshare {
+    /**
+     * Fixed-size pool of worker threads running queued tasks.
+    */
+    struct ThreadPool {
+        /**
+         * Get the default amount of workers for this machine.
+         * @returns The amount of hardware threads, at least 1.
+        */
+        static unsigned int defaultSize() {
+            unsigned int count = std::thread::hardware_concurrency();
+            return count ? count : 1;
+        }
+
+        /**
+         * Create a pool and start its workers.
+         * @param threads Amount of workers, 0 for ThreadPool::defaultSize()
+        */
+        ThreadPool(unsigned int threads = 0) {
+            if (!threads) threads = defaultSize();
+
+            for (unsigned int i = 0; i < threads; i++)
+                $workers.emplace_back([this]() -> void {
+                    for (;;) {
+                        std::function<void()> task;
+                        {
+                            std::unique_lock<std::mutex> lock ($mutex);
+                            $wake.wait(lock, [this]() { return $stop || !$tasks.empty(); });
+                            if ($stop && $tasks.empty())
+                                return;
+                            task = std::move($tasks.front());
+                            $tasks.pop();
+                        }
+                        task();
+                    }
+                });
+        }
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool & operator= (const ThreadPool &) = delete;
+
+        /**
+         * Finish all queued tasks and join the workers.
+        */
+        ~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> lock ($mutex);
+                $stop = true;
+            }
+            $wake.notify_all();
+            for (auto & worker : $workers)
+                worker.join();
+        }
+
+        /**
+         * Queue a task.
+         * @param fn The task to run
+         * @returns Future for the task's return value. Exceptions thrown
+         * by the task are rethrown from the future.
+        */
+        template<class F>
+        auto run(F && fn) -> std::future<decltype(fn())> {
+            auto task = std::make_shared<std::packaged_task<decltype(fn())()>>(std::forward<F>(fn));
+            auto res = task->get_future();
+            {
+                std::lock_guard<std::mutex> lock ($mutex);
+                $tasks.emplace([task]() -> void { (*task)(); });
+            }
+            $wake.notify_one();
+            return res;
+        }
+
+        /**
+         * Get the amount of workers in the pool.
+        */
+        unsigned int size() const {
+            return static_cast<unsigned int>($workers.size());
+        }
+
+        private:
+            std::vector<std::thread> $workers;
+            std::queue<std::function<void()>> $tasks;
+            std::mutex $mutex;
+            std::condition_variable $wake;
+            bool $stop = false;
+    };
+}
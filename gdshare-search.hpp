@@ -0,0 +1,530 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <queue>
+#include <fstream>
+#include <filesystem>
+#include <bit>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include "gdshare-codec.hpp"
+#include "gdshare-io.hpp"
+#include "gdshare-index.hpp"
+
+namespace gdshare {
+    namespace search {
+        /**
+         * Append a name in the form find compares: whitespace dropped,
+         * ASCII letters lowercased.
+        */
+        inline void normalize(std::string_view str, std::string & out) {
+            for (char c : str)
+                if (!std::isspace(static_cast<unsigned char>(c)))
+                    out += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+
+        inline std::string normalize(std::string_view str) {
+            std::string res;
+            normalize(str, res);
+            return res;
+        }
+
+        /**
+         * Substring search kernels. Each returns the first position at or
+         * after from where the needle starts, or size if there is none.
+         * The vector versions test the needle's first and last byte at 16,
+         * 32 or 64 positions at once and only compare the rest on a hit.
+        */
+        namespace findx {
+            /**
+             * Reference implementation.
+            */
+            inline size_t scalar(const uint8_t* data, size_t size, const uint8_t* needle, size_t len, size_t from) {
+                auto res = std::string_view(reinterpret_cast<const char*>(data), size)
+                    .find(std::string_view(reinterpret_cast<const char*>(needle), len), from);
+                return res == std::string_view::npos ? size : res;
+            }
+
+            #if defined(GDSHARE_X86)
+            GDSHARE_TARGET("sse2")
+            inline size_t sse2(const uint8_t* data, size_t size, const uint8_t* needle, size_t len, size_t from) {
+                const __m128i first = _mm_set1_epi8(static_cast<char>(needle[0]));
+                const __m128i last = _mm_set1_epi8(static_cast<char>(needle[len - 1]));
+                size_t i = from;
+                for (; i + len + 15 <= size; i += 16) {
+                    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+                    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + len - 1));
+                    uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(
+                        _mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last))
+                    ));
+                    for (; mask; mask &= mask - 1) {
+                        size_t pos = i + std::countr_zero(mask);
+                        if (len <= 2 || !std::memcmp(data + pos + 1, needle + 1, len - 2))
+                            return pos;
+                    }
+                }
+                return scalar(data, size, needle, len, i);
+            }
+
+            GDSHARE_TARGET("avx2")
+            inline size_t avx2(const uint8_t* data, size_t size, const uint8_t* needle, size_t len, size_t from) {
+                const __m256i first = _mm256_set1_epi8(static_cast<char>(needle[0]));
+                const __m256i last = _mm256_set1_epi8(static_cast<char>(needle[len - 1]));
+                size_t i = from;
+                for (; i + len + 31 <= size; i += 32) {
+                    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+                    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + len - 1));
+                    uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+                        _mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last))
+                    ));
+                    for (; mask; mask &= mask - 1) {
+                        size_t pos = i + std::countr_zero(mask);
+                        if (len <= 2 || !std::memcmp(data + pos + 1, needle + 1, len - 2))
+                            return pos;
+                    }
+                }
+                return sse2(data, size, needle, len, i);
+            }
+
+            GDSHARE_TARGET("avx512f,avx512bw")
+            inline size_t avx512(const uint8_t* data, size_t size, const uint8_t* needle, size_t len, size_t from) {
+                const __m512i first = _mm512_set1_epi8(static_cast<char>(needle[0]));
+                const __m512i last = _mm512_set1_epi8(static_cast<char>(needle[len - 1]));
+                size_t i = from;
+                for (; i + len + 63 <= size; i += 64) {
+                    __m512i a = _mm512_loadu_si512(data + i);
+                    __m512i b = _mm512_loadu_si512(data + i + len - 1);
+                    uint64_t mask = _cvtmask64_u64(_mm512_mask_cmpeq_epi8_mask(_mm512_cmpeq_epi8_mask(a, first), b, last));
+                    for (; mask; mask &= mask - 1) {
+                        size_t pos = i + std::countr_zero(mask);
+                        if (len <= 2 || !std::memcmp(data + pos + 1, needle + 1, len - 2))
+                            return pos;
+                    }
+                }
+                return avx2(data, size, needle, len, i);
+            }
+            #endif
+
+            /**
+             * Get the kernel for an instruction set.
+            */
+            inline size_t (*kernel(codec::Isa isa))(const uint8_t*, size_t, const uint8_t*, size_t, size_t) {
+                #if defined(GDSHARE_X86)
+                switch (isa) {
+                    case codec::Isa::AVX512: return avx512;
+                    case codec::Isa::AVX2: return avx2;
+                    case codec::Isa::SSSE3: case codec::Isa::SSE2: return sse2;
+                    default: break;
+                }
+                #endif
+                return scalar;
+            }
+        }
+
+        /**
+         * Find a substring with the fastest kernel this CPU has.
+         * @param data The buffer to search
+         * @param size Size of the buffer in bytes
+         * @param needle The substring, at least one byte
+         * @param len Length of the substring
+         * @param from Where to start searching
+         * @returns Position of the first match at or after from, or size
+        */
+        inline size_t findBytes(const uint8_t* data, size_t size, const uint8_t* needle, size_t len, size_t from = 0) {
+            static const auto fn = findx::kernel(codec::bestIsa());
+            return fn(data, size, needle, len, from);
+        }
+    }
+
+    /**
+     * Every level name of a save, normalized (see search::normalize) and
+     * packed into one buffer, so find is a single substring scan instead
+     * of a pass over every name. Build it once per load; it doesn't follow
+     * later changes to the index.
+    */
+    struct NameSearch {
+        NameSearch() = default;
+
+        /**
+         * Build from the names in an index.
+        */
+        static NameSearch build(const LevelIndex & index) {
+            NameSearch res;
+            res.$starts.reserve(index.size() + 1);
+            for (size_t ix = 0; ix < index.size(); ix++) {
+                res.$starts.push_back(static_cast<uint32_t>(res.$text.size()));
+                search::normalize(index.name(ix), res.$text);
+                // normalized names have no whitespace, so no match can
+                // run across this into the next name
+                res.$text += '\n';
+            }
+            res.$starts.push_back(static_cast<uint32_t>(res.$text.size()));
+            return res;
+        }
+
+        /**
+         * Find the levels whose name contains a term, ignoring case and
+         * whitespace.
+         * @param term The search term, as typed
+         * @returns Positions of the matching levels in the index, in order
+        */
+        std::vector<uint32_t> find(std::string_view term) const {
+            std::vector<uint32_t> res;
+            auto needle = search::normalize(term);
+            if (needle.empty()) {
+                for (uint32_t ix = 0; ix + 1 < $starts.size(); ix++)
+                    res.push_back(ix);
+                return res;
+            }
+
+            auto data = reinterpret_cast<const uint8_t*>($text.data());
+            auto bytes = reinterpret_cast<const uint8_t*>(needle.data());
+            size_t pos = 0;
+            uint32_t ix = 0;
+            while ((pos = search::findBytes(data, $text.size(), bytes, needle.size(), pos)) < $text.size()) {
+                // matches only move forward, so the level this one is in
+                // is never before the last one
+                while ($starts[ix + 1] <= pos)
+                    ix++;
+                res.push_back(ix);
+                // skip the rest of this level
+                pos = $starts[++ix];
+            }
+            return res;
+        }
+
+        /**
+         * Narrow down earlier results to the levels whose name contains a
+         * longer term.
+         * @param levels Positions of the levels to check
+         * @param needle The term, already normalized
+         * @returns The levels that match, in the same order
+        */
+        std::vector<uint32_t> refine(const std::vector<uint32_t> & levels, std::string_view needle) const {
+            std::vector<uint32_t> res;
+            for (auto ix : levels)
+                if (this->normalized(ix).find(needle) != std::string_view::npos)
+                    res.push_back(ix);
+            return res;
+        }
+
+        /**
+         * Get a level's name as find compares it.
+        */
+        std::string_view normalized(size_t ix) const {
+            return std::string_view($text.data() + $starts[ix], $starts[ix + 1] - $starts[ix] - 1);
+        }
+
+        /**
+         * Get the amount of names.
+        */
+        size_t size() const {
+            return $starts.empty() ? 0 : $starts.size() - 1;
+        }
+
+        protected:
+            std::string $text;
+            std::vector<uint32_t> $starts;
+    };
+
+    /**
+     * Search as you type. The results for every length of the query are
+     * kept, so typing a character only filters the previous results and
+     * deleting one just goes back a step.
+    */
+    struct IncrementalSearch {
+        /**
+         * Start with an empty query.
+         * @param names The names to search; must outlive this object
+         * @param order Every level's position, in the order results should
+         * be listed in
+        */
+        IncrementalSearch(const NameSearch & names, std::vector<uint32_t> order)
+          : $names(names) {
+            $sets.push_back(std::move(order));
+            $steps.push_back(0);
+        }
+
+        /**
+         * Type a character.
+        */
+        void push(char c) {
+            $query += c;
+            // whitespace is ignored, so the results stay the same
+            if (!std::isspace(static_cast<unsigned char>(c))) {
+                $needle += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+                $sets.push_back($names.refine($sets.back(), $needle));
+            }
+            $steps.push_back($sets.size() - 1);
+        }
+
+        /**
+         * Delete the last character.
+        */
+        void pop() {
+            if ($query.empty()) return;
+            if (!std::isspace(static_cast<unsigned char>($query.back())))
+                $needle.pop_back();
+            $query.pop_back();
+            $steps.pop_back();
+            while ($sets.size() - 1 > $steps.back())
+                $sets.pop_back();
+        }
+
+        /**
+         * Get the query as typed.
+        */
+        const std::string & query() const {
+            return $query;
+        }
+
+        /**
+         * Get the levels matching the current query.
+        */
+        const std::vector<uint32_t> & results() const {
+            return $sets.back();
+        }
+
+        protected:
+            const NameSearch & $names;
+            std::string $query;
+            std::string $needle;
+            // result sets, one per change of the normalized query
+            std::vector<std::vector<uint32_t>> $sets;
+            // for every length of the query, which set is current
+            std::vector<size_t> $steps;
+    };
+
+    /**
+     * Inverted index from the trigrams of every level name to the levels
+     * containing them, for fuzzy search: names are ranked by
+     * how many trigrams they share with the term (Dice coefficient), so
+     * typos and missing words still find the level. A query only walks
+     * the posting lists of its own trigrams.
+    */
+    struct TrigramIndex {
+        static constexpr uint32_t Magic = 0x49525447; // "GTRI"
+        static constexpr uint32_t Version = 1;
+
+        /**
+         * A level found by TrigramIndex::find.
+        */
+        struct Match {
+            uint32_t level;
+            float score;
+        };
+
+        TrigramIndex() = default;
+
+        /**
+         * Build from the names in an index.
+        */
+        static TrigramIndex build(const LevelIndex & index) {
+            TrigramIndex res;
+            res.$sizes.reserve(index.size());
+
+            // (trigram, level) pairs, sorted into posting lists below
+            std::vector<uint64_t> pairs;
+            std::vector<uint32_t> grams;
+            for (size_t ix = 0; ix < index.size(); ix++) {
+                trigrams(index.name(ix), grams);
+                res.$sizes.push_back(static_cast<uint16_t>(std::min<size_t>(grams.size(), UINT16_MAX)));
+                for (auto gram : grams)
+                    pairs.push_back((static_cast<uint64_t>(gram) << 32) | ix);
+            }
+            std::sort(pairs.begin(), pairs.end());
+
+            res.$postings.reserve(pairs.size());
+            for (auto pair : pairs) {
+                auto gram = static_cast<uint32_t>(pair >> 32);
+                if (res.$keys.empty() || res.$keys.back() != gram) {
+                    res.$keys.push_back(gram);
+                    res.$starts.push_back(static_cast<uint32_t>(res.$postings.size()));
+                }
+                res.$postings.push_back(static_cast<uint32_t>(pair));
+            }
+            res.$starts.push_back(static_cast<uint32_t>(res.$postings.size()));
+            return res;
+        }
+
+        /**
+         * Find the levels whose names are most like a term.
+         * @param term The search term, as typed
+         * @param count Maximum amount of results
+         * @param minScore Lowest similarity to include, from 0 to 1
+         * @returns The best matches, best first
+        */
+        std::vector<Match> find(std::string_view term, size_t count = 10, float minScore = 0.3f) const {
+            std::vector<uint32_t> grams;
+            trigrams(term, grams);
+            if (grams.empty() || !count)
+                return {};
+
+            std::vector<uint16_t> shared ($sizes.size());
+            std::vector<uint32_t> touched;
+            for (auto gram : grams) {
+                auto it = std::lower_bound($keys.begin(), $keys.end(), gram);
+                if (it == $keys.end() || *it != gram)
+                    continue;
+                size_t key = it - $keys.begin();
+                for (uint32_t ix = $starts[key]; ix < $starts[key + 1]; ix++) {
+                    uint32_t lvl = $postings[ix];
+                    if (!shared[lvl]++)
+                        touched.push_back(lvl);
+                }
+            }
+
+            // keep the best count results, worst on top
+            auto better = [](const Match & a, const Match & b) {
+                return a.score != b.score ? a.score > b.score : a.level < b.level;
+            };
+            std::priority_queue<Match, std::vector<Match>, decltype(better)> best (better);
+            for (auto lvl : touched) {
+                float score = 2.f * shared[lvl] / static_cast<float>(grams.size() + $sizes[lvl]);
+                if (score < minScore)
+                    continue;
+                if (best.size() < count)
+                    best.push({ lvl, score });
+                else if (better({ lvl, score }, best.top())) {
+                    best.pop();
+                    best.push({ lvl, score });
+                }
+            }
+
+            std::vector<Match> res (best.size());
+            for (size_t ix = res.size(); ix--; best.pop())
+                res[ix] = best.top();
+            return res;
+        }
+
+        /**
+         * Get the amount of levels.
+        */
+        size_t size() const {
+            return $sizes.size();
+        }
+
+        /**
+         * Write the index to a file.
+         * @param path The file to write
+         * @param id Identity of the save the index was built from
+         * @returns true if the file was written
+        */
+        bool save(const std::filesystem::path & path, const io::FileIdentity & id) const {
+            std::error_code err;
+            std::filesystem::create_directories(path.parent_path(), err);
+
+            auto tmp = path;
+            tmp += ".tmp";
+            {
+                std::ofstream out (tmp, std::ios::binary | std::ios::trunc);
+                if (!out.is_open()) return false;
+
+                uint32_t head[2] = { Magic, Version };
+                uint64_t sizes[3] = { $sizes.size(), $keys.size(), $postings.size() };
+                out.write(reinterpret_cast<const char*>(head), sizeof head);
+                id.write(out);
+                out.write(reinterpret_cast<const char*>(sizes), sizeof sizes);
+                out.write(reinterpret_cast<const char*>($sizes.data()), $sizes.size() * sizeof(uint16_t));
+                out.write(reinterpret_cast<const char*>($keys.data()), $keys.size() * sizeof(uint32_t));
+                out.write(reinterpret_cast<const char*>($starts.data()), $starts.size() * sizeof(uint32_t));
+                out.write(reinterpret_cast<const char*>($postings.data()), $postings.size() * sizeof(uint32_t));
+                if (!out) return false;
+            }
+
+            std::filesystem::rename(tmp, path, err);
+            return !err;
+        }
+
+        /**
+         * Read an index written with TrigramIndex::save.
+         * @param path The file to read
+         * @param id Identity of the current save; the index is rejected if
+         * it was built from a different version of the file
+         * @param out Receives the index
+         * @returns true if a matching index was read
+        */
+        static bool load(const std::filesystem::path & path, const io::FileIdentity & id, TrigramIndex & out) {
+            std::ifstream in (path, std::ios::binary);
+            if (!in.is_open()) return false;
+
+            uint32_t head[2] = { 0, 0 };
+            in.read(reinterpret_cast<char*>(head), sizeof head);
+            if (!in || head[0] != Magic || head[1] != Version)
+                return false;
+
+            io::FileIdentity built;
+            if (!built.read(in) || !(built == id))
+                return false;
+
+            uint64_t sizes[3] = { 0, 0, 0 };
+            in.read(reinterpret_cast<char*>(sizes), sizeof sizes);
+            if (!in || sizes[0] > UINT32_MAX || sizes[1] > UINT32_MAX || sizes[2] > UINT32_MAX)
+                return false;
+
+            TrigramIndex res;
+            res.$sizes.resize(sizes[0]);
+            res.$keys.resize(sizes[1]);
+            res.$starts.resize(sizes[1] + 1);
+            res.$postings.resize(sizes[2]);
+            in.read(reinterpret_cast<char*>(res.$sizes.data()), sizes[0] * sizeof(uint16_t));
+            in.read(reinterpret_cast<char*>(res.$keys.data()), sizes[1] * sizeof(uint32_t));
+            in.read(reinterpret_cast<char*>(res.$starts.data()), (sizes[1] + 1) * sizeof(uint32_t));
+            in.read(reinterpret_cast<char*>(res.$postings.data()), sizes[2] * sizeof(uint32_t));
+            if (!in) return false;
+
+            // find trusts these, so a damaged file must not get through
+            if (res.$starts.front() != 0 || res.$starts.back() != sizes[2] ||
+                !std::is_sorted(res.$starts.begin(), res.$starts.end()))
+                return false;
+            for (auto lvl : res.$postings)
+                if (lvl >= sizes[0])
+                    return false;
+
+            out = std::move(res);
+            return true;
+        }
+
+        protected:
+            /**
+             * Get the distinct trigrams of a name, sorted. Every word is
+             * lowercased and padded with a space on both sides, so word
+             * starts and ends count as well and word order doesn't matter.
+            */
+            static void trigrams(std::string_view name, std::vector<uint32_t> & out) {
+                out.clear();
+                std::string word = " ";
+                auto flush = [&]() -> void {
+                    if (word.size() == 1) return;
+                    word += ' ';
+                    for (size_t i = 0; i + 3 <= word.size(); i++)
+                        out.push_back(
+                            (static_cast<uint32_t>(static_cast<uint8_t>(word[i])) << 16) |
+                            (static_cast<uint32_t>(static_cast<uint8_t>(word[i + 1])) << 8) |
+                            static_cast<uint8_t>(word[i + 2])
+                        );
+                    word = " ";
+                };
+
+                for (char c : name) {
+                    if (std::isspace(static_cast<unsigned char>(c)))
+                        flush();
+                    else
+                        word += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+                }
+                flush();
+
+                std::sort(out.begin(), out.end());
+                out.erase(std::unique(out.begin(), out.end()), out.end());
+            }
+
+            std::vector<uint16_t> $sizes;
+            std::vector<uint32_t> $keys;
+            std::vector<uint32_t> $starts;
+            std::vector<uint32_t> $postings;
+    };
+}
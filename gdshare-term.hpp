@@ -0,0 +1,177 @@
+#pragma once
+
+#include <cstdio>
+#include <iostream>
+
+#ifdef _WIN32
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <Windows.h>
+    #include <conio.h>
+    #include <io.h>
+#else
+    #include <termios.h>
+    #include <unistd.h>
+    #include <poll.h>
+#endif
+
+namespace gdshare {
+    /**
+     * Just enough terminal handling for interactive commands: unbuffered
+     * key input and ANSI escape sequences for output. Uses termios on
+     * POSIX and the console API (with virtual terminal processing, Windows
+     * 10 and later) on Windows.
+    */
+    namespace term {
+        enum class Key {
+            Char,
+            Up,
+            Down,
+            Enter,
+            Tab,
+            Backspace,
+            Escape,
+            Interrupt,
+            End,
+            Other
+        };
+
+        /**
+         * A key press.
+        */
+        struct Input {
+            Key key;
+            // the typed character, for Key::Char
+            char c = 0;
+        };
+
+        /**
+         * Whether both input and output are a terminal.
+        */
+        inline bool isInteractive() {
+            #ifdef _WIN32
+                return _isatty(_fileno(stdin)) && _isatty(_fileno(stdout));
+            #else
+                return isatty(STDIN_FILENO) && isatty(STDOUT_FILENO);
+            #endif
+        }
+
+        /**
+         * Puts the terminal in raw mode (no line editing, no echo) and
+         * enables escape sequences for as long as it's alive.
+        */
+        struct RawMode {
+            RawMode() {
+                #ifdef _WIN32
+                    $out = GetStdHandle(STD_OUTPUT_HANDLE);
+                    $ok = GetConsoleMode($out, &$mode) &&
+                        SetConsoleMode($out, $mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+                #else
+                    if (tcgetattr(STDIN_FILENO, &$saved) == 0) {
+                        termios raw = $saved;
+                        raw.c_lflag &= ~(ICANON | ECHO | ISIG | IEXTEN);
+                        raw.c_iflag &= ~(IXON | ICRNL);
+                        raw.c_cc[VMIN] = 1;
+                        raw.c_cc[VTIME] = 0;
+                        $ok = tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) == 0;
+                    }
+                #endif
+            }
+
+            RawMode(const RawMode &) = delete;
+            RawMode & operator= (const RawMode &) = delete;
+
+            ~RawMode() {
+                if (!$ok) return;
+                #ifdef _WIN32
+                    SetConsoleMode($out, $mode);
+                #else
+                    tcsetattr(STDIN_FILENO, TCSAFLUSH, &$saved);
+                #endif
+            }
+
+            /**
+             * Whether the terminal could be switched over.
+            */
+            bool isOK() const {
+                return $ok;
+            }
+
+            protected:
+                bool $ok = false;
+                #ifdef _WIN32
+                    HANDLE $out;
+                    DWORD $mode = 0;
+                #else
+                    termios $saved;
+                #endif
+        };
+
+        #ifndef _WIN32
+        namespace detail {
+            /**
+             * Read a byte, waiting at most timeout milliseconds (-1 for
+             * no limit).
+             * @returns The byte, or -1 on timeout or end of input
+            */
+            inline int readByte(int timeout = -1) {
+                pollfd pfd { STDIN_FILENO, POLLIN, 0 };
+                if (timeout >= 0 && poll(&pfd, 1, timeout) <= 0)
+                    return -1;
+                unsigned char c;
+                return read(STDIN_FILENO, &c, 1) == 1 ? c : -1;
+            }
+        }
+        #endif
+
+        /**
+         * Wait for a key press. Needs RawMode.
+        */
+        inline Input readKey() {
+            #ifdef _WIN32
+                int c = _getch();
+                // arrow keys come as a prefix and a scan code
+                if (c == 0 || c == 224) {
+                    switch (_getch()) {
+                        case 72: return { Key::Up };
+                        case 80: return { Key::Down };
+                        default: return { Key::Other };
+                    }
+                }
+            #else
+                int c = detail::readByte();
+                if (c < 0)
+                    return { Key::End };
+                if (c == 27) {
+                    // a lone Esc, or the start of ESC [ A / ESC O A
+                    int next = detail::readByte(25);
+                    if (next != '[' && next != 'O')
+                        return { Key::Escape };
+                    int code = detail::readByte(25);
+                    // skip the parameters of longer sequences
+                    while ((code >= '0' && code <= '9') || code == ';')
+                        code = detail::readByte(25);
+                    switch (code) {
+                        case 'A': return { Key::Up };
+                        case 'B': return { Key::Down };
+                        default: return { Key::Other };
+                    }
+                }
+            #endif
+
+            switch (c) {
+                case 3: return { Key::Interrupt };
+                case 4: return { Key::End };
+                case 27: return { Key::Escape };
+                case '\r': case '\n': return { Key::Enter };
+                case '\t': return { Key::Tab };
+                case 8: case 127: return { Key::Backspace };
+                default: break;
+            }
+            if (static_cast<unsigned char>(c) >= 32)
+                return { Key::Char, static_cast<char>(c) };
+            return { Key::Other };
+        }
+    }
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <string_view>
+#include <cstring>
+#include <cctype>
+#include <charconv>
+#include "gdshare.hpp"
+#include "gdshare-keys.hpp"
+
+namespace gdshare {
+    /**
+     * Allocation-free accessors for Level. Getters return views straight
+     * into the level's XML, valid until the level's document is modified
+     * or destroyed; setters copy the value into the document's own pool.
+    */
+    namespace view {
+        /**
+         * Get the value node of a key in a level.
+         * @param level The level's XML
+         * @param key The key to find
+         * @returns The value node, or nullptr if the key does not exist.
+        */
+        inline rapidxml::xml_node<>* node(rapidxml::xml_node<>* level, std::string_view key) {
+            if (!level) return nullptr;
+            for (auto k = level->first_node("k", 1); k; k = k->next_sibling("k", 1))
+                if (std::string_view(k->value(), k->value_size()) == key)
+                    return k->next_sibling();
+            return nullptr;
+        }
+
+        /**
+         * Get the value of a key in the level.
+         * @param level The level
+         * @param key The key to get
+         * @returns Value of the key, or "" if key does not exist.
+        */
+        inline std::string_view key(const Level* level, std::string_view key) {
+            auto val = node(level->xml, key);
+            return val ? std::string_view(val->value(), val->value_size()) : std::string_view();
+        }
+
+        /**
+         * Get the value of a key as an integer.
+         * @param level The level
+         * @param key The key to get
+         * @returns Value of the key, or 0 if the key does not exist or isn't a number.
+        */
+        inline int keyInt(const Level* level, std::string_view key) {
+            auto str = view::key(level, key);
+            int res = 0;
+            std::from_chars(str.data(), str.data() + str.size(), res);
+            return res;
+        }
+
+        /**
+         * Set the value of a key in the level. The value is copied into the
+         * level's document, so the view passed in can be temporary.
+         * @param level The level
+         * @param key The key to set
+         * @param value The value to change to
+         * @param type The value's tag if the key has to be created
+         * @returns The level, like Level::key
+        */
+        inline Level* key(Level* level, std::string_view key, std::string_view value, const char* type = "s") {
+            auto doc = level->xml->document();
+            if (!doc) return level->key(std::string(key), std::string(value));
+
+            auto copy = [doc](std::string_view str) -> char* {
+                char* res = doc->allocate_string(nullptr, str.size() + 1);
+                std::memcpy(res, str.data(), str.size());
+                res[str.size()] = '\0';
+                return res;
+            };
+
+            if (auto val = node(level->xml, key)) {
+                val->value(copy(value), value.size());
+                return level;
+            }
+
+            level->xml->append_node(doc->allocate_node(rapidxml::node_element, "k", copy(key), 0, key.size()));
+            level->xml->append_node(doc->allocate_node(rapidxml::node_element, type, copy(value), 0, value.size()));
+            return level;
+        }
+
+        /**
+         * Get the value of a known key. Integer keys are parsed, others
+         * are returned as a view.
+         * @tparam K The key to get, e.g. Key::EditorTime
+         * @param level The level
+        */
+        template<Key K>
+        inline auto get(const Level* level) {
+            static_assert(K != Key::None, "get needs a key");
+            if constexpr (keys::number(K))
+                return keyInt(level, keys::gd(K));
+            else
+                return key(level, keys::gd(K));
+        }
+
+        /**
+         * Set the value of a known key.
+         * @tparam K The key to set, e.g. Key::Name
+         * @param level The level
+         * @param value The value to change to
+         * @returns The level
+        */
+        template<Key K>
+        inline Level* set(Level* level, std::string_view value) {
+            static_assert(K != Key::None, "set needs a key");
+            return key(level, keys::gd(K), value, keys::number(K) ? "i" : "s");
+        }
+
+        /**
+         * Get the name of the level.
+        */
+        inline std::string_view name(const Level* level) {
+            return get<Key::Name>(level);
+        }
+
+        /**
+         * Set the name of a level.
+        */
+        inline Level* name(Level* level, std::string_view name) {
+            return set<Key::Name>(level, name);
+        }
+
+        /**
+         * Get the creator of the level.
+        */
+        inline std::string_view creator(const Level* level) {
+            return get<Key::Creator>(level);
+        }
+
+        /**
+         * Get the level's description as stored, i.e. still Base64
+         * encoded. Level::description decodes it.
+        */
+        inline std::string_view descriptionRaw(const Level* level) {
+            return get<Key::Description>(level);
+        }
+
+        /**
+         * Get the length of a level as a string (Tiny, Short, Medium, Long, XL)
+        */
+        inline std::string_view length(const Level* level) {
+            static constexpr std::string_view lengths[] = { "Tiny", "Short", "Medium", "Long", "XL" };
+            int len = get<Key::Length>(level);
+            return lengths[len < 0 ? 0 : len > 4 ? 4 : len];
+        }
+
+        /**
+         * Check if a string contains another, ignoring case.
+         * @param str The string to search in
+         * @param term The term to search for, already lowercase
+         * @returns true if found
+        */
+        inline bool containsFolded(std::string_view str, std::string_view term) {
+            if (term.empty()) return true;
+            if (term.size() > str.size()) return false;
+
+            for (size_t i = 0; i + term.size() <= str.size(); i++) {
+                size_t j = 0;
+                while (j < term.size() && std::tolower(static_cast<unsigned char>(str[i + j])) == term[j])
+                    j++;
+                if (j == term.size())
+                    return true;
+            }
+            return false;
+        }
+    }
+}
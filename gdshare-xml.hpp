@@ -0,0 +1,207 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+#include <functional>
+#include <cstring>
+#include <algorithm>
+#include <cstdint>
+#include "rapidxml.hpp"
+
+namespace gdshare {
+    namespace xml {
+        /**
+         * Receives output in pieces. Returns false to abort.
+        */
+        using Sink = std::function<bool (const uint8_t*, size_t)>;
+
+        /**
+         * Prints a rapidxml tree without building the text in memory: the
+         * output goes through a fixed-size buffer into a sink. Produces the
+         * same text as rapidxml::print with print_no_indenting.
+        */
+        struct Writer {
+            static constexpr size_t BufferSize = 0x10000;
+
+            /**
+             * Create a writer.
+             * @param sink Where the printed text goes
+            */
+            Writer(Sink sink) : $sink(std::move(sink)) {
+                $buffer.resize(BufferSize);
+            }
+
+            /**
+             * Print a node and everything under it. For a document, prints
+             * all top-level nodes.
+             * @returns false if the sink failed
+            */
+            bool print(const rapidxml::xml_node<>* node) {
+                if (node->type() == rapidxml::node_document)
+                    for (auto child = node->first_node(); child; child = child->next_sibling())
+                        this->node(child);
+                else
+                    this->node(node);
+                return $ok;
+            }
+
+            /**
+             * Pass on whatever is still buffered.
+             * @returns false if the sink failed at any point
+            */
+            bool finish() {
+                this->flush();
+                return $ok;
+            }
+
+            protected:
+                void node(const rapidxml::xml_node<>* node) {
+                    switch (node->type()) {
+                        case rapidxml::node_element:
+                            this->element(node);
+                            break;
+
+                        case rapidxml::node_data:
+                            this->expand(text(node), 0);
+                            break;
+
+                        case rapidxml::node_cdata:
+                            this->raw("<![CDATA[");
+                            this->raw(text(node));
+                            this->raw("]]>");
+                            break;
+
+                        case rapidxml::node_declaration:
+                            this->raw("<?xml");
+                            this->attributes(node);
+                            this->raw("?>");
+                            break;
+
+                        case rapidxml::node_comment:
+                            this->raw("<!--");
+                            this->raw(text(node));
+                            this->raw("-->");
+                            break;
+
+                        case rapidxml::node_doctype:
+                            this->raw("<!DOCTYPE ");
+                            this->raw(text(node));
+                            this->raw(">");
+                            break;
+
+                        case rapidxml::node_pi:
+                            this->raw("<?");
+                            this->raw(name(node));
+                            this->raw(" ");
+                            this->raw(text(node));
+                            this->raw("?>");
+                            break;
+
+                        default:
+                            break;
+                    }
+                }
+
+                void element(const rapidxml::xml_node<>* node) {
+                    this->put('<');
+                    this->raw(name(node));
+                    this->attributes(node);
+
+                    auto child = node->first_node();
+                    if (!node->value_size() && !child) {
+                        this->raw("/>");
+                        return;
+                    }
+
+                    this->put('>');
+                    if (!child)
+                        this->expand(text(node), 0);
+                    else if (!child->next_sibling() && child->type() == rapidxml::node_data)
+                        this->expand(text(child), 0);
+                    else
+                        for (; child; child = child->next_sibling())
+                            this->node(child);
+
+                    this->raw("</");
+                    this->raw(name(node));
+                    this->put('>');
+                }
+
+                void attributes(const rapidxml::xml_node<>* node) {
+                    for (auto attr = node->first_attribute(); attr; attr = attr->next_attribute()) {
+                        std::string_view value (attr->value(), attr->value_size());
+                        char quote = value.find('"') == std::string_view::npos ? '"' : '\'';
+
+                        this->put(' ');
+                        this->raw(std::string_view(attr->name(), attr->name_size()));
+                        this->put('=');
+                        this->put(quote);
+                        this->expand(value, quote == '"' ? '\'' : '"');
+                        this->put(quote);
+                    }
+                }
+
+                static std::string_view name(const rapidxml::xml_base<>* node) {
+                    return std::string_view(node->name(), node->name_size());
+                }
+
+                static std::string_view text(const rapidxml::xml_base<>* node) {
+                    return std::string_view(node->value(), node->value_size());
+                }
+
+                /**
+                 * Write text with XML's special characters turned into
+                 * entities.
+                 * @param keep A character to leave as-is
+                */
+                void expand(std::string_view str, char keep) {
+                    size_t from = 0;
+                    for (size_t i = 0; i < str.size(); i++) {
+                        const char* entity;
+                        switch (str[i]) {
+                            case '<': entity = "&lt;"; break;
+                            case '>': entity = "&gt;"; break;
+                            case '\'': entity = "&apos;"; break;
+                            case '"': entity = "&quot;"; break;
+                            case '&': entity = "&amp;"; break;
+                            default: continue;
+                        }
+                        if (str[i] == keep) continue;
+
+                        this->raw(str.substr(from, i - from));
+                        this->raw(entity);
+                        from = i + 1;
+                    }
+                    this->raw(str.substr(from));
+                }
+
+                void put(char c) {
+                    if ($used == $buffer.size())
+                        this->flush();
+                    $buffer[$used++] = static_cast<uint8_t>(c);
+                }
+
+                void raw(std::string_view str) {
+                    while (!str.empty()) {
+                        if ($used == $buffer.size())
+                            this->flush();
+                        size_t len = std::min(str.size(), $buffer.size() - $used);
+                        std::memcpy($buffer.data() + $used, str.data(), len);
+                        $used += len;
+                        str.remove_prefix(len);
+                    }
+                }
+
+                void flush() {
+                    if ($used && $ok)
+                        $ok = $sink($buffer.data(), $used);
+                    $used = 0;
+                }
+
+                Sink $sink;
+                std::vector<uint8_t> $buffer;
+                size_t $used = 0;
+                bool $ok = true;
+        };
+    }
+}
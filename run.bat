@@ -18,7 +18,7 @@ del %NAME%
 rem compile
 
 echo Compiling x64...
-clang++ test.cpp -std=c++20 -lGDShare-x64 -lshell32 -lole32 -luser32 -o %NAME%
+clang++ test.cpp -std=c++20 -lGDShare-x64 -lzdll-x64 -lshell32 -lole32 -luser32 -lws2_32 -o %NAME%
 
 :run
 rem run test
@@ -35,11 +35,27 @@ rem compile and run 32-bit version
 del %NAME32%
 
 echo Compiling x86...
-clang++ test.cpp -std=c++20 -lGDShare-x86 -lshell32 -lole32 -o %NAME32% -m32 -Xlinker /NODEFAULTLIB:msvcrt
+clang++ test.cpp -std=c++20 -lGDShare-x86 -lzlib-x86 -lshell32 -lole32 -lws2_32 -o %NAME32% -m32 -Xlinker /NODEFAULTLIB:msvcrt
 
 echo Running...
 %NAME32%
 
 goto done
 
+:test
+
+rem build and run the self-checks
+
+echo Compiling tests...
+clang++ test-codec.cpp -std=c++20 -lzdll-x64 -o gdshare-test.exe
+clang++ test-levelfile.cpp -std=c++20 -lzdll-x64 -o gdshare-test-levelfile.exe
+clang++ test-objects.cpp -std=c++20 -o gdshare-test-objects.exe
+
+echo Running...
+gdshare-test.exe
+gdshare-test-levelfile.exe
+gdshare-test-objects.exe
+
+goto done
+
 :done
\ No newline at end of file
@@ -0,0 +1,127 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+#include "gdshare-codec.hpp"
+
+using namespace gdshare;
+
+static int failures = 0;
+
+static void check(bool ok, const std::string & what) {
+    if (!ok) {
+        std::cout << "FAIL: " << what << std::endl;
+        failures++;
+    }
+}
+
+// every instruction set up to the best one this CPU has (capped by GDSHARE_ISA)
+static std::vector<codec::Isa> isas() {
+    std::vector<codec::Isa> res;
+    for (int isa = 0; isa <= static_cast<int>(codec::bestIsa()); isa++)
+        res.push_back(static_cast<codec::Isa>(isa));
+    return res;
+}
+
+// every XOR kernel against the scalar one, on odd lengths and unaligned
+// pointers, both into another buffer and in place
+static void testXor(std::mt19937 & rng) {
+    for (int round = 0; round < 200; round++) {
+        size_t len = (rng() % 2048) | 1;
+        size_t offset = rng() % 64;
+        auto key = static_cast<uint8_t>(rng());
+
+        std::vector<uint8_t> src (len + offset);
+        for (auto & b : src) b = static_cast<uint8_t>(rng());
+        std::vector<uint8_t> expected (len);
+        codec::xorx::scalar(expected.data(), src.data() + offset, len, key);
+
+        for (auto isa : isas()) {
+            std::string name = "xor kernel " + std::to_string(static_cast<int>(isa)) +
+                " length " + std::to_string(len) + " offset " + std::to_string(offset);
+            auto fn = codec::xorx::kernel(isa);
+
+            std::vector<uint8_t> out (len + offset);
+            fn(out.data() + offset, src.data() + offset, len, key);
+            check(std::equal(expected.begin(), expected.end(), out.begin() + offset), name);
+
+            std::vector<uint8_t> inplace (src);
+            fn(inplace.data() + offset, inplace.data() + offset, len, key);
+            check(std::equal(expected.begin(), expected.end(), inplace.begin() + offset), name + " in place");
+        }
+    }
+}
+
+static void testBase64(std::mt19937 & rng) {
+    for (size_t len = 0; len <= 64; len++) {
+        std::vector<uint8_t> data (len);
+        for (auto & b : data) b = static_cast<uint8_t>(rng());
+
+        for (bool pad : { false, true }) {
+            std::string enc (codec::base64x::encodedSize(len, pad), '\0');
+            enc.resize(codec::base64Encode(data.data(), len, enc.data(), pad));
+            auto src = reinterpret_cast<const uint8_t*>(enc.data());
+            std::string name = "base64 length " + std::to_string(len) + (pad ? " padded" : " unpadded");
+
+            std::vector<uint8_t> out (codec::base64x::decodedSize(enc.size()));
+            out.resize(codec::base64Decode(src, enc.size(), out.data()));
+            check(out == data, name + ": base64Decode");
+
+            std::vector<uint8_t> inplace (enc.begin(), enc.end());
+            inplace.resize(codec::base64DecodeInPlace(inplace.data(), inplace.size()));
+            check(inplace == data, name + ": base64DecodeInPlace");
+
+            check(codec::Base64X(std::vector<uint8_t>(enc.begin(), enc.end())) == data, name + ": Base64X");
+
+            // each decode kernel on its own, finished by the scalar tail
+            for (auto isa : isas()) {
+                std::vector<uint8_t> dec (codec::base64x::decodedSize(enc.size()));
+                size_t used;
+                size_t o = codec::base64x::decoder(isa)(src, enc.size(), dec.data(), dec.size(), used);
+                codec::Base64Decoder tail;
+                size_t rest;
+                o += tail.decode(src + used, enc.size() - used, dec.data() + o, dec.size() - o, rest);
+                o += tail.finish(dec.data() + o);
+                dec.resize(o);
+                check(dec == data, name + ": decode kernel " + std::to_string(static_cast<int>(isa)));
+            }
+        }
+    }
+}
+
+// a save cut off anywhere before the end of the gzip stream is an error
+static void testTruncated(std::mt19937 & rng) {
+    std::string xml = "<?xml version=\"1.0\"?><plist><dict>";
+    while (xml.size() < 200000)
+        xml += "<k>k" + std::to_string(rng() % 1000) + "</k><s>" + std::to_string(rng()) + "</s>";
+    xml += "</dict></plist>";
+
+    auto gz = codec::GZip(reinterpret_cast<const uint8_t*>(xml.data()), xml.size());
+    std::string save (codec::base64x::encodedSize(gz.size()), '\0');
+    save.resize(codec::base64Encode(gz.data(), gz.size(), save.data()));
+    auto data = reinterpret_cast<uint8_t*>(save.data());
+    codec::xorInPlace(data, save.size(), codec::SaveKey);
+
+    std::string out;
+    check(codec::decodeX(data, save.size(), out).OK && out == xml, "decodeX of a whole save");
+
+    for (size_t size : { save.size() / 2, save.size() - 16, save.size() - 4 }) {
+        // cut on a quad so the Base64 stays valid
+        size -= size % 4;
+        check(!codec::decodeX(data, size, out).OK, "decodeX of a save cut to " + std::to_string(size) + " bytes");
+    }
+}
+
+int main() {
+    std::mt19937 rng (1);
+    testXor(rng);
+    testBase64(rng);
+    testTruncated(rng);
+
+    if (failures)
+        std::cout << failures << " checks failed" << std::endl;
+    else
+        std::cout << "All codec checks passed" << std::endl;
+    return failures ? 1 : 0;
+}
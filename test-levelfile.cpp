@@ -0,0 +1,106 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <filesystem>
+#include "gdshare-levelfile.hpp"
+
+using namespace gdshare;
+
+static int failures = 0;
+
+static void check(bool ok, const std::string & what) {
+    if (!ok) {
+        std::cout << "FAIL: " << what << std::endl;
+        failures++;
+    }
+}
+
+static std::string temp(const std::string & name) {
+    return (std::filesystem::temp_directory_path() / ("gdshare-test-" + name)).string();
+}
+
+static void put(const std::string & path, const std::string & data) {
+    std::ofstream(path, std::ios::binary) << data;
+}
+
+static std::string nameOf(const levelfile::Loaded & file) {
+    auto name = view::node(file.level, keys::gd(Key::Name));
+    return name ? std::string(name->value(), name->value_size()) : "";
+}
+
+// a file is read when its level has a name at the top of the level's dict
+static void testRead() {
+    struct Case {
+        const char* what;
+        std::string text;
+        bool ok;
+    };
+    const Case cases[] = {
+        { "plain level", "<d><k>k2</k><s>Level</s><k>k4</k><s>H4sI</s></d>", true },
+        { "level with declaration", "<?xml version=\"1.0\"?><d><k>k2</k><s>Level</s></d>", true },
+        { "plist level", "<?xml version=\"1.0\"?><plist version=\"1.0\"><dict><k>k2</k><s>Level</s></dict></plist>", true },
+        { "empty name", "<d><k>k2</k><s></s><k>k4</k><s>H4sI</s></d>", false },
+        { "no name", "<d><k>k4</k><s>H4sI</s></d>", false },
+        { "name only in a nested dict", "<d><k>k34</k><d><k>k2</k><s>Level</s></d></d>", false },
+        { "not a level", "<plist><array/></plist>", false },
+        { "not XML", "<d><k>k2</k><s>Level</d>", false },
+        { "empty file", "", false },
+    };
+
+    auto path = temp("read.gmd");
+    for (auto & test : cases) {
+        put(path, test.text);
+        levelfile::Loaded file;
+        auto res = levelfile::read(path, file);
+        check(res.OK == test.ok, std::string("read ") + test.what + ": " + res.info);
+        check(res.OK == (file.level != nullptr), std::string("read ") + test.what + " sets the level");
+        if (res.OK)
+            check(nameOf(file) == "Level" && std::strcmp(file.level->name(), "d") == 0, std::string("read ") + test.what + " finds the level");
+    }
+
+    put(path, "PK\x03\x04rest of a zip");
+    levelfile::Loaded zip;
+    check(!levelfile::read(path, zip).OK && zip.zipped, "read leaves zips to Level::load");
+
+    levelfile::Loaded missing;
+    check(!levelfile::read(temp("missing.gmd"), missing).OK && !missing.zipped, "read of a missing file");
+
+    std::filesystem::remove(path);
+}
+
+// packed .gmd and .lvl files read back as the same level
+static void testPack() {
+    std::string text = "<d><k>k2</k><s>Round &amp; trip</s><k>k4</k><s>H4sI</s><k>k34</k><d><k>a</k><i>1</i></d></d>";
+    rapidxml::xml_document<> doc;
+    doc.parse<rapidxml::parse_no_data_nodes>(text.data());
+
+    for (const char* type : { filetypes::GDShare, filetypes::LvlShare }) {
+        auto path = temp(std::string("pack.") + type);
+        auto data = levelfile::pack(doc.first_node("d"), type);
+        check(!data.empty() && levelfile::write(path, data).OK, std::string("write .") + type);
+
+        levelfile::Loaded file;
+        check(levelfile::read(path, file).OK && nameOf(file) == "Round & trip", std::string("read back .") + type);
+        check(file.level && view::node(file.level, "k34") && view::node(file.level, "k34")->first_node("k"), std::string("nested dict in .") + type);
+        std::filesystem::remove(path);
+    }
+
+    check(levelfile::pack(doc.first_node("d"), filetypes::GDShare2).empty(), "pack leaves .gmd2 to Level::exportTo");
+
+    check(levelfile::target("a/b:c", "", filetypes::GDShare) == "a_b_c.gmd", "target names the file after the level");
+    auto dir = std::filesystem::temp_directory_path();
+    check(levelfile::target("Level", dir.string(), filetypes::LvlShare) == (dir / "Level.lvl").string(), "target inside a directory");
+    check(levelfile::target("Level", "out.gmd", filetypes::GDShare) == "out.gmd", "target to a file");
+}
+
+int main() {
+    testRead();
+    testPack();
+
+    if (failures)
+        std::cout << failures << " checks failed" << std::endl;
+    else
+        std::cout << "All level file checks passed" << std::endl;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,118 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include "gdshare-objects.hpp"
+
+using namespace gdshare;
+
+static int failures = 0;
+
+static void check(bool ok, const std::string & what) {
+    if (!ok) {
+        std::cout << "FAIL: " << what << std::endl;
+        failures++;
+    }
+}
+
+// whether two tables hold the same objects, not necessarily the same text
+static bool same(const ObjectTable & a, const ObjectTable & b) {
+    if (a.size() != b.size() || a.header() != b.header())
+        return false;
+    for (size_t ix = 0; ix < a.size(); ix++) {
+        if (a.columns()[ix] != b.columns()[ix] || a.id(ix) != b.id(ix) ||
+            a.x(ix) != b.x(ix) || a.y(ix) != b.y(ix) || a.rotation(ix) != b.rotation(ix))
+            return false;
+        auto ga = a.groups(ix), gb = b.groups(ix);
+        if (!std::equal(ga.begin(), ga.end(), gb.begin(), gb.end()))
+            return false;
+        auto ea = a.extras(ix), eb = b.extras(ix);
+        if (!std::equal(ea.begin(), ea.end(), eb.begin(), eb.end(), [&](auto & x, auto & y) {
+            return x.key == y.key && a.str(x.value) == b.str(y.value);
+        }))
+            return false;
+    }
+    return true;
+}
+
+static void testRoundTrip() {
+    const std::string cases[] = {
+        "",
+        ";",
+        ";;",
+        "kA2,0,kS38,1_40_2_125;",
+        "kA2,0,kS38,1",
+        "1,1,2,15,3,15;",
+        "1,1,2,15,3,15",
+        "1,1,2,15,3;",
+        "1,1,2,15,3",
+        "1,1,2,15,abc;1,2;",
+        "kA2,0;1,1,abc",
+        "1,1,2,15,3,15;;1,8,2,45,3,15;",
+        "kA2,0;;1,1,2,15;;",
+        "1,1,2,15,3,15,6,90,57,1.2.3,21,4;",
+        "1,1,2,,3,15,,7,abc,def,57,x.y;",
+        "kA2,0;1,1,2,15,3,15,31,dGV4dA==,6;1,2;",
+    };
+
+    for (auto & text : cases) {
+        std::string name = "\"" + text + "\"";
+        auto table = ObjectTable::parse(text);
+
+        check(table.serializedBound() >= text.size(), name + ": bound");
+        check(table.serialize() == text, name + ": untouched round trip");
+
+        // rewriting every object has to keep what it holds
+        auto edited = ObjectTable::parse(text);
+        for (size_t ix = 0; ix < edited.size(); ix++)
+            edited.rotation(ix, edited.rotation(ix));
+
+        std::string out (edited.serializedBound(), '\0');
+        size_t size = edited.serialize(out.data());
+        check(size <= out.size(), name + ": edited output fits the bound");
+        out.resize(size);
+
+        auto again = ObjectTable::parse(out);
+        for (size_t ix = 0; ix < again.size(); ix++)
+            again.rotation(ix, again.rotation(ix));
+        check(same(edited, again), name + ": edited round trip gave \"" + out + "\"");
+    }
+}
+
+static void testTrailingKey() {
+    auto table = ObjectTable::parse("1,1,2,15,3;");
+    check(table.size() == 1 && table.id(0) == 1 && table.x(0) == 15, "trailing key: columns");
+    check(!(table.columns()[0] & ObjectTable::HasY), "trailing key: no y");
+
+    table.x(0, 30);
+    check(table.serialize() == "1,1,2,30,3;", "trailing key: kept after an edit");
+
+    auto raw = ObjectTable::parse("1,1,2,15,abc;1,2;");
+    check(raw.size() == 2 && raw.extras(0).size() == 1 && raw.str(raw.extras(0)[0].value) == "abc", "trailing raw key: kept alone");
+}
+
+static void testEmpty() {
+    auto empty = ObjectTable::parse("");
+    check(empty.size() == 0 && empty.header().empty() && empty.serialize().empty(), "empty string");
+
+    auto separators = ObjectTable::parse(";;");
+    check(separators.size() == 0, "only separators");
+
+    auto gaps = ObjectTable::parse("1,1;;1,2;");
+    check(gaps.size() == 2 && gaps.id(1) == 2, "empty object between two");
+
+    check(gaps.add(3, 1.5, -2) == 2, "add after an empty object");
+    check(gaps.serialize() == "1,1;1,2;1,3,2,1.5,3,-2;", "empty object dropped once edited");
+}
+
+int main() {
+    testRoundTrip();
+    testTrailingKey();
+    testEmpty();
+
+    if (failures)
+        std::cout << failures << " checks failed" << std::endl;
+    else
+        std::cout << "All object table checks passed" << std::endl;
+    return failures ? 1 : 0;
+}